@@ -0,0 +1,10 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// heap allocations made through operator new by every thread so far, counted by the replacements in alloc_stats.cpp
+std::uint64_t getAllocationCount();
+
+// highest resident memory of the process so far, in bytes
+std::size_t getPeakMemory();
@@ -0,0 +1,339 @@
+#include "batch.hpp"
+
+#include "stb_image_write.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+// true for exactly prefix or prefix:<number>, the number (when given) goes into value
+static bool parseOptionalValue(const std::string &name, const char *prefix, float &value)
+{
+    const std::size_t length = std::strlen(prefix);
+    if (name.compare(0, std::string::npos, prefix, length) == 0)
+    {
+        return true;
+    }
+    if (name.size() <= length + 1 || name.compare(0, length, prefix) != 0 || name[length] != ':')
+    {
+        return false;
+    }
+
+    char *end = nullptr;
+    float parsed = std::strtof(name.c_str() + length + 1, &end);
+    if (*end != '\0')
+    {
+        return false;
+    }
+    value = parsed;
+    return true;
+}
+
+bool parseDistanceMode(const std::string &name, WorleyDistanceMode &mode)
+{
+    if (name == "f1")
+    {
+        mode = WorleyDistanceMode::F1;
+    }
+    else if (name == "f2")
+    {
+        mode = WorleyDistanceMode::F2;
+    }
+    else if (name == "f2-f1")
+    {
+        mode = WorleyDistanceMode::F2MinusF1;
+    }
+    else if (name == "edge")
+    {
+        mode = WorleyDistanceMode::Edge;
+    }
+    else
+    {
+        return false;
+    }
+
+    return true;
+}
+
+bool parseMetric(const std::string &name, WorleyParams &params)
+{
+    if (name == "euclidean")
+    {
+        params.metric = WorleyMetric::Euclidean;
+    }
+    else if (name == "manhattan")
+    {
+        params.metric = WorleyMetric::Manhattan;
+    }
+    else if (name == "chebyshev")
+    {
+        params.metric = WorleyMetric::Chebyshev;
+    }
+    else if (parseOptionalValue(name, "minkowski", params.minkowskiExponent))
+    {
+        params.metric = WorleyMetric::Minkowski;
+        return params.minkowskiExponent > 0.0f;
+    }
+    else
+    {
+        return false;
+    }
+
+    return true;
+}
+
+bool parseDistribution(const std::string &name, WorleyParams &params)
+{
+    if (name == "uniform")
+    {
+        params.distribution = WorleyPointDistribution::Uniform;
+    }
+    else if (name == "poisson")
+    {
+        params.distribution = WorleyPointDistribution::Poisson;
+    }
+    else
+    {
+        return false;
+    }
+
+    return true;
+}
+
+bool parseRemapCurve(const std::string &name, WorleyParams &params)
+{
+    if (name == "pretty")
+    {
+        params.curve = WorleyRemapCurve::Pretty;
+    }
+    else if (name == "linear")
+    {
+        params.curve = WorleyRemapCurve::Linear;
+    }
+    else if (name == "smoothstep")
+    {
+        params.curve = WorleyRemapCurve::Smoothstep;
+    }
+    else if (parseOptionalValue(name, "gamma", params.gamma))
+    {
+        params.curve = WorleyRemapCurve::Gamma;
+        return params.gamma > 0.0f;
+    }
+    else if (name.compare(0, 4, "lut:") == 0)
+    {
+        std::ifstream file(name.substr(4));
+        params.curve = WorleyRemapCurve::Custom;
+        params.customCurve.clear();
+        unsigned int color;
+        while (params.customCurve.size() < 256 && file >> color)
+        {
+            params.customCurve.push_back(std::min(color, 255u));
+        }
+        return params.customCurve.size() == 256;
+    }
+    else
+    {
+        return false;
+    }
+
+    return true;
+}
+
+static bool parseJobChannels(const std::string &name, WorleyJobChannels &channels)
+{
+    if (name == "cells")
+    {
+        channels = WorleyJobChannels::Cells;
+    }
+    else if (name == "offsets")
+    {
+        channels = WorleyJobChannels::Offsets;
+    }
+    else
+    {
+        return false;
+    }
+
+    return true;
+}
+
+static std::string getExtension(const std::string &filename)
+{
+    return filename.substr(filename.find_last_of('.') + 1);
+}
+
+static bool isDistanceFormat(const std::string &filename)
+{
+    std::string extension = getExtension(filename);
+    return extension == "hdr" || extension == "f32";
+}
+
+bool parseWorleyJob(const std::string &line, WorleyJob &job)
+{
+    std::istringstream stream(line);
+    std::string mode, option;
+    bool parsed = (bool)(stream >> job.params.seed >> job.params.size >> job.params.points >> mode >> job.output);
+    while (parsed && stream >> option)
+    {
+        parsed = parseMetric(option, job.params) || parseDistribution(option, job.params) || parseRemapCurve(option, job.params) ||
+                 parseJobChannels(option, job.channels);
+    }
+
+    // cells are colors, offsets need floats
+    bool formatMatches = job.channels == WorleyJobChannels::Noise || isDistanceFormat(job.output) == (job.channels == WorleyJobChannels::Offsets);
+    return parsed && formatMatches && job.params.size > 0 && job.params.size <= WORLEY_JOB_MAX_SIZE && job.params.points > 0 &&
+           job.params.points <= WORLEY_JOB_MAX_POINTS && parseDistanceMode(mode, job.params.mode);
+}
+
+bool loadWorleyJobs(const std::string &filename, std::vector<WorleyJob> &jobs)
+{
+    std::ifstream file(filename);
+    if (!file)
+    {
+        std::cout << "\tError: Could not open " << filename << std::endl;
+        return false;
+    }
+
+    std::string line;
+    for (int lineNumber = 1; std::getline(file, line); lineNumber++)
+    {
+        std::istringstream stream(line);
+        std::string first;
+        if (!(stream >> first) || first[0] == '#')
+        {
+            continue;
+        }
+
+        WorleyJob job;
+        if (!parseWorleyJob(line, job))
+        {
+            std::cout << "\tError: " << filename << ":" << lineNumber << " is not a valid job." << std::endl;
+            return false;
+        }
+
+        jobs.push_back(job);
+    }
+
+    return true;
+}
+
+static void appendEncoded(void *context, void *data, int size)
+{
+    std::vector<std::uint8_t> *encoded = (std::vector<std::uint8_t> *)context;
+    encoded->insert(encoded->end(), (std::uint8_t *)data, (std::uint8_t *)data + size);
+}
+
+bool encodeWorleyImage(const std::string &filename, const std::vector<std::uint8_t> &pixels, unsigned int width, unsigned int height, std::vector<std::uint8_t> &encoded, unsigned int channels)
+{
+    encoded.clear();
+    std::string extension = getExtension(filename);
+    if (extension == "png")
+    {
+        return stbi_write_png_to_func(appendEncoded, &encoded, width, height, channels, pixels.data(), width * channels) != 0;
+    }
+    if (extension == "bmp")
+    {
+        return stbi_write_bmp_to_func(appendEncoded, &encoded, width, height, channels, pixels.data()) != 0;
+    }
+    if (extension == "tga")
+    {
+        return stbi_write_tga_to_func(appendEncoded, &encoded, width, height, channels, pixels.data()) != 0;
+    }
+
+    return false;
+}
+
+bool encodeWorleyDistances(const std::string &filename, const std::vector<float> &distances, unsigned int width, unsigned int height, std::vector<std::uint8_t> &encoded)
+{
+    encoded.clear();
+    std::string extension = getExtension(filename);
+    if (extension == "hdr")
+    {
+        return stbi_write_hdr_to_func(appendEncoded, &encoded, width, height, 3, distances.data()) != 0;
+    }
+    if (extension == "f32")
+    {
+        const std::uint8_t *bytes = (const std::uint8_t *)distances.data();
+        encoded.assign(bytes, bytes + distances.size() * sizeof(float));
+        return true;
+    }
+
+    return false;
+}
+
+bool encodeWorleyJob(const WorleyJob &job, WorleyGenerator &generator, std::vector<std::uint8_t> &pixels, std::vector<float> &floats, std::vector<std::uint8_t> &encoded)
+{
+    generator.update(job.params);
+    if (job.channels == WorleyJobChannels::Cells)
+    {
+        generator.renderCells(pixels);
+        return encodeWorleyImage(job.output, pixels, job.params.size, job.params.size, encoded, 3);
+    }
+    if (job.channels == WorleyJobChannels::Offsets)
+    {
+        generator.renderOffsets(floats);
+        return encodeWorleyDistances(job.output, floats, job.params.size, job.params.size, encoded);
+    }
+    if (isDistanceFormat(job.output))
+    {
+        generator.renderDistances(floats);
+        return encodeWorleyDistances(job.output, floats, job.params.size, job.params.size, encoded);
+    }
+
+    generator.render(pixels, 1);
+    return encodeWorleyImage(job.output, pixels, job.params.size, job.params.size, encoded);
+}
+
+unsigned int runWorleyJobs(const std::vector<WorleyJob> &jobs, ThreadPool &pool, FileWriter &writer, ResultCache *cache)
+{
+    struct Shared
+    {
+        std::atomic<unsigned int> failed{0};
+        FileWriter &writer;
+        ResultCache *cache;
+    } shared{{0}, writer, cache};
+
+    // two references fit the inline storage of std::function, so queueing a job doesn't allocate
+    for (const WorleyJob &job : jobs)
+    {
+        pool.submit([&job, &shared]()
+        {
+            std::atomic<unsigned int> &failed = shared.failed;
+            FileWriter &writer = shared.writer;
+            ResultCache *cache = shared.cache;
+            const char *channelNames[] = {"", ":cells", ":offsets"};
+            std::uint64_t key = hashWorleyParams(job.params, getExtension(job.output) + channelNames[(int)job.channels]);
+            if (cache && cache->fetch(key, job.output))
+            {
+                return;
+            }
+
+            // scratch lives as long as the worker thread
+            thread_local WorleyGenerator generator;
+            thread_local std::vector<std::uint8_t> pixels;
+            thread_local std::vector<float> distances;
+            std::vector<std::uint8_t> encoded = writer.acquireBuffer();
+
+            if (!encodeWorleyJob(job, generator, pixels, distances, encoded))
+            {
+                std::cout << "\tError: Could not write " << job.output << std::endl;
+                failed++;
+                return;
+            }
+
+            if (cache)
+            {
+                cache->store(key, encoded);
+            }
+            // the writer owns the encoded file from here and recycles its buffer, the worker moves on to its next job
+            writer.submit(job.output, std::move(encoded));
+        });
+    }
+    pool.wait();
+
+    return shared.failed + writer.finish();
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "file_writer.hpp"
+#include "result_cache.hpp"
+#include "thread_pool.hpp"
+#include "worley.hpp"
+
+// what a job writes besides the noise itself
+enum class WorleyJobChannels
+{
+    Noise,   // toned noise, or the untoned distances for hdr and f32
+    Cells,   // cell colors, see WorleyGenerator::renderCells
+    Offsets  // closest point offsets and indices, see WorleyGenerator::renderOffsets
+};
+
+struct WorleyJob
+{
+    WorleyParams params;
+    std::string output;
+    WorleyJobChannels channels = WorleyJobChannels::Noise;
+};
+
+// Largest tile and point count a job may ask for. A generator keeps about 20 bytes per pixel, so a 4096 tile already
+// takes over 300 MiB per worker, and size * size has to stay far from overflowing. The C library takes the same
+// size limit (WORLEY_MAX_SIZE).
+const unsigned int WORLEY_JOB_MAX_SIZE = 4096;
+const unsigned int WORLEY_JOB_MAX_POINTS = 1u << 20;
+
+// parameter parsers shared by the job files and the command line, false on unknown names
+bool parseDistanceMode(const std::string &name, WorleyDistanceMode &mode);
+bool parseMetric(const std::string &name, WorleyParams &params);
+bool parseDistribution(const std::string &name, WorleyParams &params);
+// pretty, linear, gamma[:exponent], smoothstep or lut:file with 256 colors from closest to furthest
+bool parseRemapCurve(const std::string &name, WorleyParams &params);
+
+// parses one job line (see loadWorleyJobs), false when it is malformed or past the limits above
+bool parseWorleyJob(const std::string &line, WorleyJob &job);
+
+// Reads one job per line: seed size points mode output [options], mode being f1, f2, f2-f1 or edge. The options are
+// any of a metric (euclidean, manhattan, chebyshev or minkowski[:exponent]), a point distribution (uniform or
+// poisson), a remap curve (see parseRemapCurve) and cells (png, bmp or tga) or offsets (hdr or f32) to write those
+// channels instead of the noise.
+// Blank lines and lines starting with # are skipped. Returns false on the first malformed line.
+bool loadWorleyJobs(const std::string &filename, std::vector<WorleyJob> &jobs);
+
+// encodes an image of 1 (noise) or 3 (cells) channels, the format follows the extension of filename (png, bmp or tga)
+// hdr and f32 outputs get the untoned distances instead, see encodeWorleyDistances
+bool encodeWorleyImage(const std::string &filename, const std::vector<std::uint8_t> &pixels, unsigned int width, unsigned int height, std::vector<std::uint8_t> &encoded, unsigned int channels = 1);
+
+// encodes RGB floats like the distances from WorleyGenerator::renderDistances, as radiance hdr or raw float32 (f32)
+bool encodeWorleyDistances(const std::string &filename, const std::vector<float> &distances, unsigned int width, unsigned int height, std::vector<std::uint8_t> &encoded);
+
+// Generates a job with the caller's generator and scratch buffers and encodes it for the extension of its output,
+// false when the format doesn't fit.
+bool encodeWorleyJob(const WorleyJob &job, WorleyGenerator &generator, std::vector<std::uint8_t> &pixels, std::vector<float> &floats, std::vector<std::uint8_t> &encoded);
+
+// Runs every job on the pool, each worker reusing its generator and pixel buffers between jobs, and hands the encoded
+// files to writer. With a cache, jobs whose exact output is already cached skip generation entirely.
+// Returns the number of jobs that failed, once every file is written.
+unsigned int runWorleyJobs(const std::vector<WorleyJob> &jobs, ThreadPool &pool, FileWriter &writer, ResultCache *cache = nullptr);
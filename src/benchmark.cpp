@@ -0,0 +1,77 @@
+#include "benchmark.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <vector>
+
+#include "alloc_stats.hpp"
+#include "worley.hpp"
+
+struct BenchmarkCase
+{
+    unsigned int size;
+    unsigned int points;
+    WorleyPointDistribution distribution;
+};
+
+// times full rebuilds, allocations gets the heap allocations per tile once the buffers are warm
+static double timeGeneration(WorleyParams params, unsigned int iterations, double &allocations)
+{
+    WorleyGenerator generator;
+    std::vector<std::uint8_t> pixels;
+    params.seed = 0;
+    generator.update(params);
+    generator.render(pixels, 1);
+
+    std::uint64_t allocationsBefore = getAllocationCount();
+    auto start = std::chrono::steady_clock::now();
+    for (unsigned int i = 0; i < iterations; i++)
+    {
+        // a new seed every time so every iteration is a full rebuild
+        params.seed = i + 1;
+        generator.update(params);
+        generator.render(pixels, 1);
+    }
+    std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+    allocations = (double)(getAllocationCount() - allocationsBefore) / iterations;
+    return elapsed.count() / iterations;
+}
+
+bool runWorleyBenchmark()
+{
+    const BenchmarkCase cases[] = {{64, 13, WorleyPointDistribution::Uniform}, {64, 200, WorleyPointDistribution::Uniform},
+                                   {256, 13, WorleyPointDistribution::Uniform}, {256, 200, WorleyPointDistribution::Uniform},
+                                   {256, 200, WorleyPointDistribution::Poisson}};
+    const char *distributionNames[] = {"uniform", "poisson"};
+    const char *metricNames[] = {"euclidean", "manhattan", "chebyshev", "minkowski"};
+    const unsigned int METRICS = 4;
+
+    unsigned int allocatingCases = 0;
+    std::printf("%-10s %6s %7s %-8s %14s %12s %12s\n", "metric", "size", "points", "dist", "ns/tile", "ns/pixel", "allocs/tile");
+    for (unsigned int metric = 0; metric < METRICS; metric++)
+    {
+        for (const BenchmarkCase &benchmarkCase : cases)
+        {
+            WorleyParams params;
+            params.size = benchmarkCase.size;
+            params.points = benchmarkCase.points;
+            params.metric = (WorleyMetric)metric;
+            params.distribution = benchmarkCase.distribution;
+
+            // aim for roughly the same amount of work per case
+            unsigned int iterations = std::max(1u, 200000000u / (params.size * params.size * params.points));
+            double allocations;
+            double tile = timeGeneration(params, iterations, allocations);
+            std::printf("%-10s %6u %7u %-8s %14.0f %12.2f %12.2f\n", metricNames[metric], params.size, params.points,
+                        distributionNames[(int)params.distribution], tile, tile / (params.size * params.size), allocations);
+            allocatingCases += allocations > 0.0;
+        }
+    }
+
+    if (allocatingCases > 0)
+    {
+        std::printf("\tError: %u cases allocated on the heap once the generator was warm\n", allocatingCases);
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,5 @@
+#pragma once
+
+// Times the generator over a fixed set of sizes, point counts and metrics and prints the results. Returns false when a
+// warm generator still allocated on the heap in any case.
+bool runWorleyBenchmark();
@@ -0,0 +1,202 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+
+// Fixed capacity queue for any number of producers and consumers, without locks: every cell carries a sequence number
+// telling whose turn it is, producers and consumers only race on their own index (Vyukov's bounded queue).
+// push and pop spin for a few tries, then sleep on a condition variable until the other side moves, so a full queue
+// holds its producers back instead of growing. The mutex is only taken when somebody sleeps.
+template <typename T>
+class BoundedQueue
+{
+public:
+    // capacity gets rounded up to a power of two
+    explicit BoundedQueue(std::size_t capacity)
+    {
+        std::size_t cells = 1;
+        while (cells < capacity)
+        {
+            cells <<= 1;
+        }
+        _cells.reset(new Cell[cells]);
+        _mask = cells - 1;
+        for (std::size_t i = 0; i < cells; i++)
+        {
+            _cells[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    BoundedQueue(const BoundedQueue &) = delete;
+    BoundedQueue &operator=(const BoundedQueue &) = delete;
+
+    // moves value in unless the queue is full
+    bool tryPush(T &value)
+    {
+        std::size_t position = _pushPosition.load(std::memory_order_relaxed);
+        while (true)
+        {
+            Cell &cell = _cells[position & _mask];
+            std::size_t sequence = cell.sequence.load(std::memory_order_acquire);
+            std::ptrdiff_t turn = (std::ptrdiff_t)sequence - (std::ptrdiff_t)position;
+            if (turn == 0)
+            {
+                if (_pushPosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+                {
+                    cell.value = std::move(value);
+                    cell.sequence.store(position + 1, std::memory_order_release);
+                    return true;
+                }
+            }
+            else if (turn < 0)
+            {
+                return false;
+            }
+            else
+            {
+                position = _pushPosition.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    // moves the oldest value out unless the queue is empty
+    bool tryPop(T &value)
+    {
+        std::size_t position = _popPosition.load(std::memory_order_relaxed);
+        while (true)
+        {
+            Cell &cell = _cells[position & _mask];
+            std::size_t sequence = cell.sequence.load(std::memory_order_acquire);
+            std::ptrdiff_t turn = (std::ptrdiff_t)sequence - (std::ptrdiff_t)(position + 1);
+            if (turn == 0)
+            {
+                if (_popPosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+                {
+                    value = std::move(cell.value);
+                    cell.sequence.store(position + _mask + 1, std::memory_order_release);
+                    return true;
+                }
+            }
+            else if (turn < 0)
+            {
+                return false;
+            }
+            else
+            {
+                position = _popPosition.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    void push(T value)
+    {
+        for (int spin = 0; spin < SPIN_TRIES; spin++)
+        {
+            if (tryPush(value))
+            {
+                wake(_popWaiters, _notEmpty);
+                return;
+            }
+            std::this_thread::yield();
+        }
+
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _pushWaiters.fetch_add(1);
+            // a pop after the count is up sees it, one before it freed the cell tryPush finds
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            while (!tryPush(value))
+            {
+                _notFull.wait(lock);
+            }
+            _pushWaiters.fetch_sub(1);
+        }
+        wake(_popWaiters, _notEmpty);
+    }
+
+    // waits for a value, false once the queue is closed and drained
+    bool pop(T &value)
+    {
+        for (int spin = 0; spin < SPIN_TRIES; spin++)
+        {
+            if (tryPop(value))
+            {
+                wake(_pushWaiters, _notFull);
+                return true;
+            }
+            if (_closed.load(std::memory_order_acquire))
+            {
+                break;
+            }
+            std::this_thread::yield();
+        }
+
+        bool popped;
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _popWaiters.fetch_add(1);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            // everything pushed before close is visible once closed is
+            while (!(popped = tryPop(value)) && !_closed.load(std::memory_order_acquire))
+            {
+                _notEmpty.wait(lock);
+            }
+            _popWaiters.fetch_sub(1);
+            if (!popped)
+            {
+                popped = tryPop(value);
+            }
+        }
+        if (popped)
+        {
+            wake(_pushWaiters, _notFull);
+        }
+        return popped;
+    }
+
+    // called once every producer is done, lets pop return false when nothing is left
+    void close()
+    {
+        _closed.store(true, std::memory_order_release);
+        std::lock_guard<std::mutex> lock(_mutex);
+        _notEmpty.notify_all();
+    }
+
+private:
+    // tries before push and pop go to sleep, a few microseconds of yielding
+    static const int SPIN_TRIES = 64;
+
+    // after a push or pop, wakes a sleeper of the other side if there is one
+    void wake(const std::atomic<unsigned int> &waiters, std::condition_variable &condition)
+    {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (waiters.load(std::memory_order_relaxed) > 0)
+        {
+            // under the mutex, so it can't fall between a sleeper's last try and its wait
+            std::lock_guard<std::mutex> lock(_mutex);
+            condition.notify_one();
+        }
+    }
+
+    struct Cell
+    {
+        std::atomic<std::size_t> sequence;
+        T value;
+    };
+
+    std::unique_ptr<Cell[]> _cells;
+    std::size_t _mask = 0;
+    // apart, so producers and consumers don't fight over one cache line
+    alignas(64) std::atomic<std::size_t> _pushPosition{0};
+    alignas(64) std::atomic<std::size_t> _popPosition{0};
+    std::atomic<bool> _closed{false};
+
+    std::mutex _mutex;
+    std::condition_variable _notFull, _notEmpty;
+    std::atomic<unsigned int> _pushWaiters{0}, _popWaiters{0};
+};
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+// Recycles the byte buffers handed from one thread to another (encoded files on their way to the disk), so once every
+// buffer in flight has grown to the size of a file nobody allocates for them anymore.
+class BufferPool
+{
+public:
+    // an empty buffer, with the capacity of a released one when there is one
+    std::vector<std::uint8_t> acquire()
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (_free.empty())
+        {
+            return {};
+        }
+
+        std::vector<std::uint8_t> buffer = std::move(_free.back());
+        _free.pop_back();
+        return buffer;
+    }
+
+    void release(std::vector<std::uint8_t> buffer)
+    {
+        buffer.clear();
+        std::lock_guard<std::mutex> lock(_mutex);
+        _free.push_back(std::move(buffer));
+    }
+
+private:
+    std::mutex _mutex;
+    std::vector<std::vector<std::uint8_t>> _free;
+};
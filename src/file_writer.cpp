@@ -0,0 +1,465 @@
+#include "file_writer.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+#include <fcntl.h>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+// files per batch, also the submission queue size
+const unsigned int RING_ENTRIES = 64;
+
+// how long a broken ring gets to hand back the writes it already took, in milliseconds
+const unsigned int RING_DRAIN_MS = 5000;
+
+// the ring shared with the kernel, set up by hand through the raw syscalls so liburing isn't needed
+struct FileWriter::Ring
+{
+    int fd = -1;
+    void *sqMapping = MAP_FAILED, *cqMapping = MAP_FAILED;
+    std::size_t sqSize = 0, cqSize = 0;
+    io_uring_sqe *sqes = (io_uring_sqe *)MAP_FAILED;
+    std::size_t sqesSize = 0;
+    unsigned int *sqTail, *sqMask, *sqArray;
+    unsigned int *cqHead, *cqTail, *cqMask;
+    io_uring_cqe *cqes;
+
+    // per file scratch of writeBatch, kept so batches don't allocate
+    std::vector<int> fds;
+    std::vector<std::size_t> written;
+    std::vector<char> failed, inFlight;
+    std::vector<iovec> buffers, remaining;
+    // buffers of writes a broken ring never handed back, the kernel may still read them
+    std::vector<std::vector<std::uint8_t>> abandoned;
+
+    ~Ring()
+    {
+        tearDown();
+    }
+
+    // Reaps completions without entering the ring until inFlight writes are back, false when they don't come back in
+    // time. Completions may wait for this thread's next system call to get posted, the sleep between the looks is one.
+    template <typename Complete>
+    bool drain(unsigned int inFlight, Complete complete)
+    {
+        for (unsigned int waited = 0; inFlight > 0 && waited < RING_DRAIN_MS; waited++)
+        {
+            inFlight -= std::min(inFlight, reap(complete));
+            if (inFlight > 0)
+            {
+                usleep(1000);
+            }
+        }
+        return inFlight == 0;
+    }
+
+    // hands every posted completion to complete, returns how many there were
+    template <typename Complete>
+    unsigned int reap(Complete complete)
+    {
+        unsigned int head = *cqHead;
+        unsigned int tail = __atomic_load_n(cqTail, __ATOMIC_ACQUIRE);
+        unsigned int count = tail - head;
+        for (; head != tail; head++)
+        {
+            complete(cqes[head & *cqMask]);
+        }
+        __atomic_store_n(cqHead, head, __ATOMIC_RELEASE);
+        return count;
+    }
+
+    // unmaps and closes the ring, later batches see fd < 0
+    void tearDown()
+    {
+        if (sqes != MAP_FAILED)
+        {
+            munmap(sqes, sqesSize);
+            sqes = (io_uring_sqe *)MAP_FAILED;
+        }
+        if (cqMapping != MAP_FAILED && cqMapping != sqMapping)
+        {
+            munmap(cqMapping, cqSize);
+        }
+        cqMapping = MAP_FAILED;
+        if (sqMapping != MAP_FAILED)
+        {
+            munmap(sqMapping, sqSize);
+            sqMapping = MAP_FAILED;
+        }
+        if (fd >= 0)
+        {
+            close(fd);
+            fd = -1;
+        }
+    }
+};
+
+static int enterRing(int fd, unsigned int toSubmit, unsigned int minComplete)
+{
+    return syscall(__NR_io_uring_enter, fd, toSubmit, minComplete, IORING_ENTER_GETEVENTS, nullptr, 0);
+}
+
+static int registerRing(int fd, unsigned int opcode, void *arg, unsigned int count)
+{
+    return syscall(__NR_io_uring_register, fd, opcode, arg, count);
+}
+
+// writes data from offset on to the open file, false on an error
+static bool writePlainRest(int fd, const std::vector<std::uint8_t> &data, std::size_t offset)
+{
+    while (offset < data.size())
+    {
+        ssize_t written = pwrite(fd, data.data() + offset, data.size() - offset, offset);
+        if (written < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (written <= 0)
+        {
+            return false;
+        }
+        offset += written;
+    }
+    return true;
+}
+
+// writes a whole file the plain way, false (and reported) when that fails
+static bool writePlainFile(const std::string &filename, const std::vector<std::uint8_t> &data)
+{
+    std::ofstream stream(filename, std::ios::binary);
+    stream.write((const char *)data.data(), data.size());
+    if (!stream)
+    {
+        std::cout << "\tError: Could not write " << filename << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// null when io_uring is missing or not allowed (old kernels, seccomp, containers)
+FileWriter::Ring *FileWriter::createRing()
+{
+    io_uring_params params{};
+    int fd = syscall(__NR_io_uring_setup, RING_ENTRIES, &params);
+    if (fd < 0)
+    {
+        return nullptr;
+    }
+
+    std::unique_ptr<Ring> ring(new Ring());
+    ring->fd = fd;
+    ring->sqSize = params.sq_off.array + params.sq_entries * sizeof(unsigned int);
+    ring->cqSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    if (params.features & IORING_FEAT_SINGLE_MMAP)
+    {
+        ring->sqSize = ring->cqSize = std::max(ring->sqSize, ring->cqSize);
+    }
+
+    ring->sqMapping = mmap(nullptr, ring->sqSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+    if (ring->sqMapping == MAP_FAILED)
+    {
+        return nullptr;
+    }
+    ring->cqMapping = ring->sqMapping;
+    if (!(params.features & IORING_FEAT_SINGLE_MMAP))
+    {
+        ring->cqMapping = mmap(nullptr, ring->cqSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+        if (ring->cqMapping == MAP_FAILED)
+        {
+            return nullptr;
+        }
+    }
+    ring->sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+    ring->sqes = (io_uring_sqe *)mmap(nullptr, ring->sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+    if (ring->sqes == MAP_FAILED)
+    {
+        return nullptr;
+    }
+
+    std::uint8_t *sq = (std::uint8_t *)ring->sqMapping, *cq = (std::uint8_t *)ring->cqMapping;
+    ring->sqTail = (unsigned int *)(sq + params.sq_off.tail);
+    ring->sqMask = (unsigned int *)(sq + params.sq_off.ring_mask);
+    ring->sqArray = (unsigned int *)(sq + params.sq_off.array);
+    ring->cqHead = (unsigned int *)(cq + params.cq_off.head);
+    ring->cqTail = (unsigned int *)(cq + params.cq_off.tail);
+    ring->cqMask = (unsigned int *)(cq + params.cq_off.ring_mask);
+    ring->cqes = (io_uring_cqe *)(cq + params.cq_off.cqes);
+    return ring.release();
+}
+
+FileWriter::FileWriter(unsigned int numThreads, unsigned int maxQueued, bool allowUring)
+    : _maxQueued(std::max(1u, maxQueued))
+{
+    if (allowUring)
+    {
+        _ring.reset(createRing());
+    }
+    if (_ring)
+    {
+        _ringThread = std::thread(&FileWriter::runRing, this);
+    }
+    else
+    {
+        _pool.reset(new ThreadPool(numThreads));
+    }
+}
+
+FileWriter::~FileWriter()
+{
+    finish();
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _stopping = true;
+    }
+    _changed.notify_all();
+    if (_ringThread.joinable())
+    {
+        _ringThread.join();
+    }
+}
+
+void FileWriter::submit(const std::string &filename, std::vector<std::uint8_t> data)
+{
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        _changed.wait(lock, [this]() { return _inFlight < _maxQueued; });
+        _inFlight++;
+        if (_ring)
+        {
+            _pending.push_back(PendingFile{filename, std::move(data)});
+            _changed.notify_all();
+            return;
+        }
+    }
+
+    std::shared_ptr<PendingFile> file(new PendingFile{filename, std::move(data)});
+    _pool->submit([this, file]() { writeFile(*file); });
+}
+
+unsigned int FileWriter::finish()
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+    _changed.wait(lock, [this]() { return _inFlight == 0; });
+    unsigned int failed = _failed;
+    _failed = 0;
+    return failed;
+}
+
+void FileWriter::writeFile(PendingFile &file)
+{
+    bool written = writePlainFile(file.filename, file.data);
+    _buffers.release(std::move(file.data));
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    _failed += written ? 0 : 1;
+    _inFlight--;
+    _changed.notify_all();
+}
+
+void FileWriter::runRing()
+{
+    std::vector<PendingFile> batch;
+    while (true)
+    {
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _changed.wait(lock, [this]() { return _stopping || !_pending.empty(); });
+            if (_pending.empty())
+            {
+                return;
+            }
+
+            // whatever piled up while the last batch was in flight
+            unsigned int count = std::min<std::size_t>(_pending.size(), RING_ENTRIES);
+            batch.assign(std::make_move_iterator(_pending.begin()), std::make_move_iterator(_pending.begin() + count));
+            _pending.erase(_pending.begin(), _pending.begin() + count);
+        }
+
+        unsigned int failed = writeBatch(batch);
+        for (PendingFile &file : batch)
+        {
+            _buffers.release(std::move(file.data));
+        }
+
+        std::lock_guard<std::mutex> lock(_mutex);
+        _failed += failed;
+        _inFlight -= batch.size();
+        _changed.notify_all();
+    }
+}
+
+unsigned int FileWriter::writeBatch(std::vector<PendingFile> &batch)
+{
+    Ring &ring = *_ring;
+    const unsigned int count = batch.size();
+    if (ring.fd < 0)
+    {
+        // the ring broke on an earlier batch, the rest goes the plain way from this thread
+        unsigned int failures = 0;
+        for (const PendingFile &file : batch)
+        {
+            failures += writePlainFile(file.filename, file.data) ? 0 : 1;
+        }
+        return failures;
+    }
+
+    std::vector<int> &fds = ring.fds;
+    std::vector<std::size_t> &written = ring.written;
+    std::vector<char> &failed = ring.failed;
+    std::vector<char> &inFlight = ring.inFlight;
+    fds.resize(count);
+    written.assign(count, 0);
+    failed.assign(count, false);
+    inFlight.assign(count, false);
+    for (unsigned int i = 0; i < count; i++)
+    {
+        fds[i] = open(batch[i].filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0666);
+        failed[i] = fds[i] < 0;
+    }
+
+    // registered buffers stay pinned for the whole batch, saving the kernel from mapping them on every write;
+    // when the memlock limit says no the writes take the plain iovecs
+    std::vector<iovec> &buffers = ring.buffers;
+    buffers.resize(count);
+    for (unsigned int i = 0; i < count; i++)
+    {
+        buffers[i] = iovec{batch[i].data.data(), batch[i].data.size()};
+    }
+    bool registered = std::all_of(batch.begin(), batch.end(), [](const PendingFile &file) { return !file.data.empty(); }) &&
+                      registerRing(ring.fd, IORING_REGISTER_BUFFERS, buffers.data(), count) == 0;
+
+    // every round writes what the previous one left, usually everything goes in the first
+    std::vector<iovec> &remaining = ring.remaining;
+    remaining.resize(count);
+    bool broken = false;
+    while (!broken)
+    {
+        unsigned int queued = 0;
+        unsigned int tail = *ring.sqTail;
+        for (unsigned int i = 0; i < count; i++)
+        {
+            if (failed[i] || written[i] == batch[i].data.size())
+            {
+                continue;
+            }
+
+            unsigned int slot = tail & *ring.sqMask;
+            io_uring_sqe &sqe = ring.sqes[slot];
+            std::memset(&sqe, 0, sizeof(sqe));
+            sqe.fd = fds[i];
+            sqe.off = written[i];
+            sqe.user_data = i;
+            if (registered)
+            {
+                sqe.opcode = IORING_OP_WRITE_FIXED;
+                sqe.addr = (std::uint64_t)(batch[i].data.data() + written[i]);
+                sqe.len = batch[i].data.size() - written[i];
+                sqe.buf_index = i;
+            }
+            else
+            {
+                remaining[i] = iovec{batch[i].data.data() + written[i], batch[i].data.size() - written[i]};
+                sqe.opcode = IORING_OP_WRITEV;
+                sqe.addr = (std::uint64_t)&remaining[i];
+                sqe.len = 1;
+            }
+            ring.sqArray[slot] = slot;
+            inFlight[i] = true;
+            tail++;
+            queued++;
+        }
+        if (queued == 0)
+        {
+            break;
+        }
+        __atomic_store_n(ring.sqTail, tail, __ATOMIC_RELEASE);
+
+        // one enter submits the whole round, then completions get reaped until every write is back
+        auto complete = [&](const io_uring_cqe &cqe)
+        {
+            unsigned int i = cqe.user_data;
+            inFlight[i] = false;
+            if (cqe.res > 0)
+            {
+                written[i] += cqe.res;
+            }
+            else
+            {
+                failed[i] = true;
+            }
+        };
+        unsigned int toSubmit = queued, completed = 0;
+        while (completed < queued)
+        {
+            int submitted = enterRing(ring.fd, toSubmit, 1);
+            if (submitted < 0)
+            {
+                if (errno == EINTR || errno == EAGAIN || errno == EBUSY)
+                {
+                    continue;
+                }
+
+                // The ring is unusable, but the writes the kernel already took may still be reading the buffers and the
+                // iovecs. Those get drained before anything is released or closed, then the ring goes away and the
+                // files it didn't finish are written the plain way. Writes that never came back fail their file, and
+                // their buffers are kept for good.
+                std::cout << "\tError: io_uring_enter failed: " << std::strerror(errno) << ", writing without io_uring from now on" << std::endl;
+                broken = true;
+                if (!ring.drain(queued - toSubmit - completed, complete))
+                {
+                    for (unsigned int i = 0; i < count; i++)
+                    {
+                        if (inFlight[i])
+                        {
+                            failed[i] = true;
+                            ring.abandoned.push_back(std::move(batch[i].data));
+                        }
+                    }
+                }
+                break;
+            }
+            toSubmit -= std::min<unsigned int>(toSubmit, submitted);
+            completed += ring.reap(complete);
+        }
+    }
+
+    if (broken)
+    {
+        ring.tearDown();
+
+        // whatever the ring left short goes on from where it stopped, the completed files stay as they are
+        for (unsigned int i = 0; i < count; i++)
+        {
+            if (!failed[i] && written[i] < batch[i].data.size())
+            {
+                failed[i] = !writePlainRest(fds[i], batch[i].data, written[i]);
+            }
+        }
+    }
+    else if (registered)
+    {
+        registerRing(ring.fd, IORING_UNREGISTER_BUFFERS, nullptr, 0);
+    }
+
+    unsigned int failures = 0;
+    for (unsigned int i = 0; i < count; i++)
+    {
+        if (fds[i] >= 0 && close(fds[i]) != 0)
+        {
+            failed[i] = true;
+        }
+        if (failed[i])
+        {
+            std::cout << "\tError: Could not write " << batch[i].filename << std::endl;
+            failures++;
+        }
+    }
+    return failures;
+}
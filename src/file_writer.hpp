@@ -0,0 +1,65 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "buffer_pool.hpp"
+#include "thread_pool.hpp"
+
+// Writes whole files in the background, so the threads producing them never wait on the disk.
+// Uses io_uring when the kernel allows it: everything submitted while the previous batch was in flight goes out as
+// the next batch, one io_uring_enter for all of its writes, from buffers registered with the ring for the batch.
+// Otherwise the files get written by a small thread pool.
+class FileWriter
+{
+public:
+    // Threads of the fallback pool, maxQueued files waiting or in flight before submit blocks, allowUring false
+    // always takes the fallback.
+    explicit FileWriter(unsigned int numThreads, unsigned int maxQueued = 64, bool allowUring = true);
+    ~FileWriter();
+
+    FileWriter(const FileWriter &) = delete;
+    FileWriter &operator=(const FileWriter &) = delete;
+
+    // queues data for filename and returns right away unless maxQueued files are already queued
+    void submit(const std::string &filename, std::vector<std::uint8_t> data);
+
+    // an empty buffer to encode the next file into, recycled from an already written file when there is one
+    std::vector<std::uint8_t> acquireBuffer() { return _buffers.acquire(); }
+
+    // waits for everything submitted so far, returns how many of those files could not be written
+    unsigned int finish();
+
+    bool usesUring() const { return _ring != nullptr; }
+
+private:
+    struct PendingFile
+    {
+        std::string filename;
+        std::vector<std::uint8_t> data;
+    };
+    struct Ring;
+
+    static Ring *createRing();
+    void runRing();
+    unsigned int writeBatch(std::vector<PendingFile> &batch);
+    void writeFile(PendingFile &file);
+
+    std::unique_ptr<Ring> _ring;
+    std::unique_ptr<ThreadPool> _pool; // fallback
+    BufferPool _buffers; // data of the written files
+
+    std::mutex _mutex;
+    std::condition_variable _changed;
+    std::vector<PendingFile> _pending; // waiting for the next batch
+    unsigned int _inFlight = 0;        // submitted and not written yet
+    unsigned int _maxQueued;
+    unsigned int _failed = 0;
+    bool _stopping = false;
+    std::thread _ringThread; // last, so everything it uses exists before it starts
+};
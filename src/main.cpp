@@ -2,129 +2,611 @@
 #include "stb_image_write.h"
 
 #include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <cmath>
 #include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
 #include <iostream>
+#include <memory>
 #include <mutex>
 #include <random>
+#include <stdexcept>
 #include <thread>
-#include <unordered_map>
 #include <vector>
 
 #include <SFML/Graphics.hpp>
 
+#include "alloc_stats.hpp"
+#include "batch.hpp"
+#include "benchmark.hpp"
+#include "bounded_queue.hpp"
+#include "file_writer.hpp"
+#include "mipmap.hpp"
+#include "numa.hpp"
+#include "server.hpp"
+#include "thread_pool.hpp"
+#include "volume.hpp"
+#include "worker_processes.hpp"
+#include "worley.hpp"
+
 const unsigned int SPRITESHEET_SIZE = 512;
 const unsigned int TEXTURE_SLICES = 64;
 const unsigned int TEXTURE_SLICE_ROW = sqrt(TEXTURE_SLICES);
 const unsigned int TEXTURE_SIZE = SPRITESHEET_SIZE / TEXTURE_SLICE_ROW;
-const unsigned int TILED_TEXTURE_SIZE = TEXTURE_SIZE * 3;
 const unsigned int WORLEY_POINTS = 13;
 const unsigned int TEXTURE_PIXELS = TEXTURE_SIZE * TEXTURE_SIZE;
+const unsigned int MAX_WORLEY_OCTAVES = 4;
+const unsigned int PIPELINE_QUEUE_SLICES = 8;
+// --volume slices go up to the size batch jobs take, and a brick has to fit in memory at once
+const unsigned int MAX_VOLUME_SIZE = WORLEY_JOB_MAX_SIZE;
+const std::uint64_t MAX_BRICK_BYTES = 1ull << 30;
 
-std::unordered_map<int, std::vector<sf::Uint8>> worleyTiles;
+// Every slice of the volume one after another, allocated once before generating. Page aligned and never written
+// before the slice threads render into it (a slice is a page), so with --numa every slice's memory lands on the node
+// of the pinned thread that touches it first.
+struct FreeDeleter
+{
+    void operator()(void *memory) const { std::free(memory); }
+};
+std::unique_ptr<sf::Uint8[], FreeDeleter> worleyTiles;
+const std::size_t TILES_ALIGNMENT = 4096;
 std::mutex _MUTEX;
+std::vector<unsigned int> sliceThreadCpus; // cpu per slice thread with --numa, empty leaves them unpinned
+
+// the part of the volume a run writes, set by --slices and --region
+struct VolumeRange
+{
+    int firstSlice = 0;
+    int sliceCount = TEXTURE_SLICES;
+    sf::IntRect region{0, 0, (int)TEXTURE_SIZE, (int)TEXTURE_SIZE}; // of every slice
+
+    bool isWhole() const { return sliceCount == TEXTURE_SLICES && region == sf::IntRect(0, 0, TEXTURE_SIZE, TEXTURE_SIZE); }
+};
+VolumeRange volumeRange;
+
+sf::Uint8 *getWorleyTile(int index)
+{
+    return &worleyTiles[index * TEXTURE_PIXELS];
+}
 
-struct Point
+// Updates the slices of a range, then either renders them into their tiles or only adds their distances to histogram.
+// generators holds one generator per slice when later passes need the fields of every slice, empty otherwise, and
+// then every thread goes through its slices with a generator of its own.
+void generateWorleyNoiseSlices(int index, int count, std::vector<WorleyGenerator> &generators, const std::vector<WorleyParams> &sliceParams, std::vector<unsigned int> *histogram)
 {
-    int x;
-    int y;
+    thread_local WorleyGenerator threadGenerator;
+    std::vector<unsigned int> bins;
+    for (int i = index; i < index + count; i++)
+    {
+        WorleyGenerator &generator = generators.empty() ? threadGenerator : generators[i];
+        generator.update(sliceParams[i]);
+        if (histogram)
+        {
+            generator.accumulateHistogram(bins);
+            continue;
+        }
+
+        // the tiles don't overlap, the threads write theirs without a lock
+        generator.render(getWorleyTile(i), TEXTURE_SIZE, 1);
+    }
+
+    // merge this thread's histogram
+    if (histogram)
+    {
+        std::lock_guard<std::mutex> lock(_MUTEX);
+        histogram->resize(bins.size());
+        for (int i = 0; i < bins.size(); i++)
+        {
+            (*histogram)[i] += bins[i];
+        }
+    }
+}
+
+// the part-th of parts contiguous ranges the count slices from index get split into, the last one takes the rest
+void splitSlices(int index, int count, unsigned int parts, unsigned int part, int &partIndex, int &partCount)
+{
+    int slicesPerPart = count / parts;
+    partIndex = index + part * slicesPerPart;
+    partCount = (part == parts - 1) ? index + count - partIndex : slicesPerPart;
+}
+
+// splits the count slices from index over the threads, contiguous ranges in slice order
+void runSliceThreads(unsigned int numThreads, int index, int count, const std::function<void(int, int)> &generateSlices)
+{
+    numThreads = std::max(1, std::min<int>(numThreads, count));
+    std::vector<std::thread> threads;
+    std::atomic<unsigned int> unpinned{0};
+    for (int i = 0; i < numThreads; i++)
+    {
+        int threadSliceIndex, threadSlices;
+        splitSlices(index, count, numThreads, i, threadSliceIndex, threadSlices);
+        if (sliceThreadCpus.empty())
+        {
+            threads.emplace_back(generateSlices, threadSliceIndex, threadSlices);
+            continue;
+        }
+
+        // the same slices land on the same cpu every run, so the buffers a thread first touched stay on its node
+        unsigned int cpu = sliceThreadCpus[i % sliceThreadCpus.size()];
+        threads.emplace_back([&generateSlices, &unpinned, cpu, threadSliceIndex, threadSlices]()
+        {
+            if (!pinThreadToCpu(cpu))
+            {
+                unpinned++;
+            }
+            generateSlices(threadSliceIndex, threadSlices);
+        });
+    }
+    for (std::thread &thread : threads)
+    {
+        if (thread.joinable())
+        {
+            thread.join();
+        }
+    }
 
-    double distanceTo(const Point &other) const
+    if (unpinned > 0)
     {
-        return std::sqrt(std::pow(x - other.x, 2) + std::pow(y - other.y, 2));
+        std::cout << "\tError: Could not pin " << unpinned << " of " << numThreads << " slice threads to their cpus, they ran unpinned" << std::endl;
     }
+}
+
+// copies the region of a slice of size * size pixels, row by row
+template <typename T>
+void cropSlice(const T *slice, unsigned int size, unsigned int channels, const sf::IntRect &region, std::vector<T> &cropped)
+{
+    cropped.resize(region.width * region.height * channels);
+    for (int y = 0; y < region.height; y++)
+    {
+        std::copy_n(&slice[((region.top + y) * size + region.left) * channels], region.width * channels, &cropped[y * region.width * channels]);
+    }
+}
+
+std::vector<sf::Uint8> getWorleyNoiseSlice(int index)
+{
+    return std::vector<sf::Uint8>(getWorleyTile(index), getWorleyTile(index) + TEXTURE_PIXELS);
+}
+
+// Generates the slices of volumeRange and writes them as BMPs in three overlapping stages: the slice threads generate,
+// one thread encodes the slices as they get done and the writer writes them out. A bounded queue holds the slice
+// threads back and the writer's submit blocks the encoder once enough files are queued, so the whole thing takes
+// about as long as the slowest stage.
+bool writeWorleySliceFiles(std::vector<WorleyGenerator> &generators, const std::vector<WorleyParams> &sliceParams, unsigned int numThreads, const std::vector<std::string> &filenames, FileWriter &writer)
+{
+    BoundedQueue<int> generated(PIPELINE_QUEUE_SLICES);
+    std::thread encoder([&]()
+    {
+        int index;
+        std::vector<sf::Uint8> cropped;
+        while (generated.pop(index))
+        {
+            // the slice won't change anymore; the region, the whole slice by default, is copied into reused scratch
+            const sf::IntRect &region = volumeRange.region;
+            cropSlice(getWorleyTile(index), TEXTURE_SIZE, 1, region, cropped);
+
+            std::vector<std::uint8_t> bmp = writer.acquireBuffer();
+            encodeWorleyImage(filenames[index], cropped, region.width, region.height, bmp);
+            writer.submit(filenames[index], std::move(bmp));
+        }
+    });
+
+    runSliceThreads(numThreads, volumeRange.firstSlice, volumeRange.sliceCount, [&](int index, int count)
+    {
+        for (int i = index; i < index + count; i++)
+        {
+            generateWorleyNoiseSlices(i, 1, generators, sliceParams, nullptr);
+            generated.push(i);
+        }
+    });
+    generated.close();
+    encoder.join();
+
+    return writer.finish() == 0;
+}
+
+std::string getFrameFilename(int slice, unsigned int frame)
+{
+    return "worleyFrame_" + std::to_string(frame) + "_slice_" + std::to_string(slice) + ".bmp";
+}
+
+// Writes every frame of the time loop of the slices in volumeRange. The (slice, frame) pairs get split over the
+// threads slice by slice, so a thread's generator steps through consecutive frames of a slice and only moves the
+// points between them, and the frames of a slice are generated in parallel when there are more threads than slices.
+bool writeWorleyFrames(const std::vector<WorleyParams> &sliceParams, unsigned int numThreads, FileWriter &writer)
+{
+    const unsigned int frames = sliceParams[0].frames;
+    runSliceThreads(numThreads, 0, volumeRange.sliceCount * frames, [&](int index, int count)
+    {
+        const sf::IntRect &region = volumeRange.region;
+        WorleyGenerator generator;
+        WorleyParams params;
+        std::vector<std::uint8_t> pixels, cropped;
+        for (int i = index; i < index + count; i++)
+        {
+            int slice = volumeRange.firstSlice + i / frames;
+            params = sliceParams[slice];
+            params.frame = i % frames;
+            generator.update(params);
+            generator.render(pixels, 1);
+            if (region.width != TEXTURE_SIZE || region.height != TEXTURE_SIZE)
+            {
+                cropSlice(pixels.data(), TEXTURE_SIZE, 1, region, cropped);
+                pixels.swap(cropped);
+            }
+
+            std::string filename = getFrameFilename(slice, params.frame);
+            std::vector<std::uint8_t> bmp = writer.acquireBuffer();
+            encodeWorleyImage(filename, pixels, region.width, region.height, bmp);
+            writer.submit(filename, std::move(bmp));
+        }
+    });
+
+    return writer.finish() == 0;
+}
+
+// a slice in the memory shared with the worker processes, followed by its encoded file
+struct SharedSlice
+{
+    std::uint32_t fileSize;
+    std::uint8_t pixels[TEXTURE_PIXELS]; // the whole slice, whatever the region
+
+    std::uint8_t *file() { return (std::uint8_t *)(this + 1); }
 };
 
-int remap(int value, int min, int max, int newMin, int newMax)
+// Generates the slices of volumeRange in numProcesses forked worker processes, a contiguous shard each with its own
+// threads, rendering and encoding them straight into shared memory. This process only collects the encoded files,
+// the same bytes writeWorleySliceFiles writes, into files by slice. With normalize a first round of workers fills the
+// histograms and the tone range reaches the second round through sliceParams.
+// Forks, so it has to run before anything starts threads.
+bool generateWorleySliceFilesSharded(std::vector<WorleyParams> &sliceParams, unsigned int numProcesses, bool normalize, float normalizePercentile, const std::vector<std::string> &filenames, std::vector<std::vector<std::uint8_t>> &files)
 {
-    return newMin + (value - min) * (newMax - newMin) / (max - min);
+    const unsigned int threadsPerProcess = std::max(1u, std::thread::hardware_concurrency() / numProcesses);
+    if (normalize)
+    {
+        SharedMemory histograms(numProcesses * WORLEY_HISTOGRAM_BINS * sizeof(unsigned int));
+        if (!histograms.data())
+        {
+            return false;
+        }
+
+        unsigned int failed = runWorkerProcesses(numProcesses, [&](unsigned int process)
+        {
+            int index, count;
+            splitSlices(0, TEXTURE_SLICES, numProcesses, process, index, count);
+            std::vector<WorleyGenerator> generators; // a generator per thread
+            std::vector<unsigned int> histogram(WORLEY_HISTOGRAM_BINS);
+            runSliceThreads(threadsPerProcess, index, count, [&](int index, int count)
+            {
+                generateWorleyNoiseSlices(index, count, generators, sliceParams, &histogram);
+            });
+            std::copy(histogram.begin(), histogram.end(), (unsigned int *)histograms.data() + process * WORLEY_HISTOGRAM_BINS);
+            return true;
+        });
+        if (failed > 0)
+        {
+            std::cout << "\tError: " << failed << " of the histogram processes failed" << std::endl;
+            return false;
+        }
+
+        std::vector<unsigned int> histogram(WORLEY_HISTOGRAM_BINS);
+        for (unsigned int i = 0; i < numProcesses * WORLEY_HISTOGRAM_BINS; i++)
+        {
+            histogram[i % WORLEY_HISTOGRAM_BINS] += ((const unsigned int *)histograms.data())[i];
+        }
+        float rangeMin, rangeMax;
+        findWorleyToneRange(histogram, TEXTURE_SIZE, normalizePercentile, rangeMin, rangeMax);
+        std::cout << "Normalized distances to [" << rangeMin << ", " << rangeMax << "]" << std::endl;
+        for (WorleyParams &params : sliceParams)
+        {
+            params.rangeMin = rangeMin;
+            params.rangeMax = rangeMax;
+        }
+    }
+
+    // room for a 24 bit image with padded rows and headers, more than any of the formats takes for one channel
+    const sf::IntRect &region = volumeRange.region;
+    const std::size_t fileCapacity = 1024 + region.height * (region.width * 3 + 4);
+    const std::size_t sliceBytes = (sizeof(SharedSlice) + fileCapacity + 63) / 64 * 64;
+    SharedMemory shared(sliceBytes * TEXTURE_SLICES);
+    if (!shared.data())
+    {
+        return false;
+    }
+    auto getSlice = [&shared, sliceBytes](int index) { return (SharedSlice *)((std::uint8_t *)shared.data() + index * sliceBytes); };
+
+    unsigned int failed = runWorkerProcesses(numProcesses, [&](unsigned int process)
+    {
+        int index, count;
+        splitSlices(volumeRange.firstSlice, volumeRange.sliceCount, numProcesses, process, index, count);
+        std::atomic<bool> fits{true};
+        runSliceThreads(threadsPerProcess, index, count, [&](int index, int count)
+        {
+            WorleyGenerator generator;
+            std::vector<std::uint8_t> cropped, encoded;
+            for (int i = index; i < index + count; i++)
+            {
+                generator.update(sliceParams[i]);
+                SharedSlice &slice = *getSlice(i);
+                generator.render(slice.pixels, TEXTURE_SIZE, 1);
+                cropSlice(slice.pixels, TEXTURE_SIZE, 1, region, cropped);
+
+                encodeWorleyImage(filenames[i], cropped, region.width, region.height, encoded);
+                if (encoded.size() > fileCapacity)
+                {
+                    fits = false;
+                    continue;
+                }
+                std::copy(encoded.begin(), encoded.end(), slice.file());
+                slice.fileSize = encoded.size();
+            }
+        });
+        return fits.load();
+    });
+    if (failed > 0)
+    {
+        std::cout << "\tError: " << failed << " of the slice processes failed" << std::endl;
+        return false;
+    }
+
+    // the noise stays around for the mips like in a single process
+    files.resize(TEXTURE_SLICES);
+    for (int i = volumeRange.firstSlice; i < volumeRange.firstSlice + volumeRange.sliceCount; i++)
+    {
+        SharedSlice &slice = *getSlice(i);
+        std::copy_n(slice.pixels, TEXTURE_PIXELS, getWorleyTile(i));
+        files[i].assign(slice.file(), slice.file() + slice.fileSize);
+    }
+    return true;
 }
 
-std::vector<sf::Uint8> generateTiledWorleyNoise(std::random_device &randomDevice)
+// regenerates the preview noise off the UI thread, a newer request cancels the stale ones
+class PreviewGenerator
 {
-    // generate random seed
-    std::mt19937 rand(randomDevice());
+public:
+    PreviewGenerator()
+        : _pool(1)
+    {
+    }
 
-    // generate points
-    std::vector<Point> worleyPoints;
-    std::uniform_int_distribution<int> d(0, TEXTURE_SIZE - 1);
-    for (int i = 0; i < WORLEY_POINTS; i++)
+    ~PreviewGenerator()
     {
-        Point worleyPoint{d(rand), d(rand)};
-        worleyPoints.push_back(worleyPoint);
+        // cancel whatever is still running before the pool joins
+        _latestRequest++;
     }
 
-    // tile the points
-    const unsigned int TILED_WORLEY_POINTS = WORLEY_POINTS * 9;
-    std::vector<Point> tiledWorleyPoints;
-    unsigned int worleyTile;
-    for (int y = 0; y < 3; y++)
+    void request(const WorleyParams &params)
     {
-        for (int x = 0; x < 3; x++)
+        unsigned int request = ++_latestRequest;
+        _pool.submit([this, params, request]()
         {
-            worleyTile = y * 3 + x;
-            for (int i = 0; i < WORLEY_POINTS; i++)
+            auto isStale = [this, request]() { return request != _latestRequest; };
+            if (isStale())
             {
-                Point worleyPoint = worleyPoints.at(i);
-                worleyPoint.x += x * TEXTURE_SIZE;
-                worleyPoint.y += y * TEXTURE_SIZE;
-                tiledWorleyPoints.push_back(worleyPoint);
+                return;
             }
+
+            _generator.update(params, [this, &isStale](unsigned int step)
+            {
+                // publish every pass into the back buffer
+                std::lock_guard<std::mutex> lock(_mutex);
+                if (!isStale())
+                {
+                    _generator.render(_backBuffer, 4, step);
+                    _ready = true;
+                }
+            }, isStale);
+        });
+    }
+
+    // swaps the finished back buffer into pixels, false while nothing new is ready
+    bool takeResult(std::vector<sf::Uint8> &pixels)
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (!_ready)
+        {
+            return false;
+        }
+
+        pixels.swap(_backBuffer);
+        _ready = false;
+        return true;
+    }
+
+private:
+    WorleyGenerator _generator; // only touched by the worker, requests run one after another
+    std::atomic<unsigned int> _latestRequest{0};
+    std::mutex _mutex;
+    std::vector<sf::Uint8> _backBuffer;
+    bool _ready = false;
+    ThreadPool _pool; // last, so it joins before the buffers go away
+};
+
+std::string getPreviewTitle(const WorleyParams &params)
+{
+    const char *modes[] = {"F1", "F2", "F2-F1", "edge"};
+    const char *metrics[] = {"euclidean", "manhattan", "chebyshev", "minkowski"};
+    const char *curves[] = {"pretty", "linear", "gamma", "smoothstep", "custom"};
+    const char *distributions[] = {"uniform", "poisson"};
+    return "Tileable Worley Noise (Preview) - " + std::to_string(params.points) + " " + distributions[(int)params.distribution] + " points, " +
+           modes[(int)params.mode] + ", " + metrics[(int)params.metric] + ", " + curves[(int)params.curve] + ", " +
+           std::to_string(params.octaves) + " octaves";
+}
+
+void writeMipAtlas(const std::string &filename, const std::vector<MipSlice> &slices, unsigned int size, unsigned int channels = 1)
+{
+    // lay the slices out row by row in a square grid
+    const unsigned int columns = std::ceil(std::sqrt((double)slices.size()));
+    const unsigned int rows = (slices.size() + columns - 1) / columns;
+    const unsigned int width = columns * size;
+    std::vector<std::uint8_t> atlas(width * rows * size * channels);
+    for (int i = 0; i < slices.size(); i++)
+    {
+        unsigned int atlasX = (i % columns) * size;
+        unsigned int atlasY = (i / columns) * size;
+        for (int y = 0; y < size; y++)
+        {
+            std::copy_n(&slices[i][y * size * channels], size * channels, &atlas[((atlasY + y) * width + atlasX) * channels]);
+        }
+    }
+
+    stbi_write_png(filename.c_str(), width, rows * size, channels, atlas.data(), width * channels);
+}
+
+void writeWorleyMipChains(MipFilter filter, unsigned int numThreads)
+{
+    std::vector<MipSlice> slices;
+    for (int i = 0; i < TEXTURE_SLICES; i++)
+    {
+        slices.push_back(getWorleyNoiseSlice(i));
+    }
+
+    // per slice 2D mips, one spritesheet per level
+    std::vector<std::vector<MipSlice>> sliceChains = generateSliceMipChains(slices, TEXTURE_SIZE, filter, numThreads);
+    for (int level = 0; level < sliceChains[0].size(); level++)
+    {
+        std::vector<MipSlice> levelSlices;
+        for (const std::vector<MipSlice> &chain : sliceChains)
+        {
+            levelSlices.push_back(chain[level]);
         }
+        writeMipAtlas("worleySpritesheet_mip" + std::to_string(level) + ".png", levelSlices, TEXTURE_SIZE >> level);
     }
 
-    // generate the tiled texture
-    const unsigned int TILED_TEXTURE_PIXELS = TILED_TEXTURE_SIZE * TILED_TEXTURE_SIZE * 4;
-    std::vector<sf::Uint8> tiledPixels(TILED_TEXTURE_PIXELS);
-    unsigned int color, index;
-    for (int y = 0; y < TILED_TEXTURE_SIZE; y++)
+    // 3D volume mips, slices get halved too
+    std::vector<MipVolumeLevel> volumeChain = generateVolumeMipChain(slices, TEXTURE_SIZE, filter, numThreads);
+    for (int level = 0; level < volumeChain.size(); level++)
     {
-        for (int x = 0; x < TILED_TEXTURE_SIZE; x++)
+        writeMipAtlas("worleyVolume_mip" + std::to_string(level) + ".png", volumeChain[level].slices, volumeChain[level].size);
+    }
+}
+
+// writes the cell colors of every slice as one spritesheet
+void writeWorleyCells(const std::string &filename, std::vector<WorleyGenerator> &generators, unsigned int numThreads)
+{
+    std::vector<MipSlice> slices(TEXTURE_SLICES);
+    runSliceThreads(numThreads, 0, TEXTURE_SLICES, [&](int index, int count)
+    {
+        for (int i = index; i < index + count; i++)
         {
-            // get current pixel coordinates
-            Point current{x, y};
+            generators[i].renderCells(slices[i]);
+        }
+    });
+
+    writeMipAtlas(filename, slices, TEXTURE_SIZE, 3);
+}
 
-            // get closest worley point distance
-            std::vector<int> distances = std::vector<int>();
-            for (int i = 0; i < TILED_WORLEY_POINTS; i++)
+// Writes RGB floats of every slice (the untoned distances or the closest point offsets), as one spritesheet for hdr
+// or stacked slices for f32. f32 only stacks the regions of the slices in volumeRange.
+bool writeWorleyFloats(const std::string &filename, std::vector<WorleyGenerator> &generators, void (WorleyGenerator::*render)(std::vector<float> &) const, unsigned int numThreads)
+{
+    std::vector<std::vector<float>> sliceDistances(TEXTURE_SLICES);
+    runSliceThreads(numThreads, volumeRange.firstSlice, volumeRange.sliceCount, [&](int index, int count)
+    {
+        const bool cropped = volumeRange.region != sf::IntRect(0, 0, TEXTURE_SIZE, TEXTURE_SIZE);
+        std::vector<float> slice;
+        for (int i = index; i < index + count; i++)
+        {
+            (generators[i].*render)(cropped ? slice : sliceDistances[i]);
+            if (cropped)
             {
-                distances.push_back(current.distanceTo(tiledWorleyPoints[i]));
+                cropSlice(slice.data(), TEXTURE_SIZE, 3, volumeRange.region, sliceDistances[i]);
             }
-            std::sort(distances.begin(), distances.end());
-            color = std::min(distances[0], 255);
-            color = 255 - std::min(remap(color, 0, 255, 0, 2048), 255); // remap for pretty
+        }
+    });
 
-            // set the pixel value
-            index = (y * TILED_TEXTURE_SIZE + x) * 4;
-            tiledPixels[index + 0] = color;
-            tiledPixels[index + 1] = color;
-            tiledPixels[index + 2] = color;
-            tiledPixels[index + 3] = 255;
+    std::vector<float> distances;
+    unsigned int width = volumeRange.region.width, height = volumeRange.region.height * volumeRange.sliceCount;
+    if (filename.substr(filename.find_last_of('.') + 1) == "hdr")
+    {
+        width = height = SPRITESHEET_SIZE;
+        distances.resize(SPRITESHEET_SIZE * SPRITESHEET_SIZE * 3);
+        for (int i = 0; i < TEXTURE_SLICES; i++)
+        {
+            unsigned int sliceX = (i % TEXTURE_SLICE_ROW) * TEXTURE_SIZE;
+            unsigned int sliceY = (i / TEXTURE_SLICE_ROW) * TEXTURE_SIZE;
+            for (int y = 0; y < TEXTURE_SIZE; y++)
+            {
+                std::copy_n(&sliceDistances[i][y * TEXTURE_SIZE * 3], TEXTURE_SIZE * 3, &distances[((sliceY + y) * SPRITESHEET_SIZE + sliceX) * 3]);
+            }
+        }
+    }
+    else
+    {
+        for (const std::vector<float> &slice : sliceDistances)
+        {
+            distances.insert(distances.end(), slice.begin(), slice.end());
         }
     }
 
-    return tiledPixels;
+    std::vector<std::uint8_t> encoded;
+    if (!encodeWorleyDistances(filename, distances, width, height, encoded))
+    {
+        return false;
+    }
+    std::ofstream file(filename, std::ios::binary);
+    file.write((const char *)encoded.data(), encoded.size());
+    return (bool)file;
 }
 
-void generateWorleyNoiseSlices(int index, int count, std::random_device &randomDevice)
+// a whole number from 0 to max, anything else throws like std::stoul does
+unsigned int parseUnsigned(const std::string &text, unsigned long max)
 {
-    for (int i = index; i < index + count; i++)
+    std::size_t end;
+    unsigned long value = std::stoul(text, &end);
+    if (end != text.size() || text.find('-') != std::string::npos)
     {
-        std::lock_guard<std::mutex> lock(_MUTEX);
-        worleyTiles[i] = generateTiledWorleyNoise(randomDevice);
+        throw std::invalid_argument(text);
     }
+    if (value > max)
+    {
+        throw std::out_of_range(text);
+    }
+    return value;
 }
 
-std::vector<sf::Uint8> getWorleyNoiseSlice(int index)
+// a number and nothing after it, anything else throws like std::stof does
+float parseFloat(const std::string &text)
+{
+    std::size_t end;
+    float value = std::stof(text, &end);
+    if (end != text.size())
+    {
+        throw std::invalid_argument(text);
+    }
+    return value;
+}
+
+// a:b, the slices from a up to but not including b
+bool parseSliceRange(const std::string &text, VolumeRange &range)
+{
+    int first, last;
+    char rest;
+    if (std::sscanf(text.c_str(), "%d:%d%c", &first, &last, &rest) != 2 || first < 0 || last <= first || last > TEXTURE_SLICES)
+    {
+        return false;
+    }
+
+    range.firstSlice = first;
+    range.sliceCount = last - first;
+    return true;
+}
+
+// x,y,w,h in pixels of a slice
+bool parseSliceRegion(const std::string &text, VolumeRange &range)
 {
-    std::lock_guard<std::mutex> lock(_MUTEX);
-    auto slicesIt = worleyTiles.find(index);
-    if (slicesIt != worleyTiles.end())
+    int x, y, width, height;
+    char rest;
+    if (std::sscanf(text.c_str(), "%d,%d,%d,%d%c", &x, &y, &width, &height, &rest) != 4 || x < 0 || y < 0 || width <= 0 ||
+        height <= 0 || x + width > TEXTURE_SIZE || y + height > TEXTURE_SIZE)
     {
-        return slicesIt->second;
+        return false;
     }
 
-    return {};
+    range.region = sf::IntRect(x, y, width, height);
+    return true;
 }
 
 int main(int argc, char *argv[])
@@ -132,32 +614,262 @@ int main(int argc, char *argv[])
     // initialize random engine
     std::random_device randomDevice;
 
-    // check if we just preview
+    // parse the arguments
     bool preview = false;
-    if (argc > 1)
+    bool mips = false;
+    bool cells = false;
+    bool numa = false;
+    bool uring = true;
+    bool fixedSeed = false;
+    unsigned int numProcesses = 1;
+    unsigned int volumeSeed = 0;
+    unsigned int cubeSize = 0;
+    unsigned int brickSlices = 64;
+    MipFilter mipFilter = MipFilter::Box;
+    std::string batchFile;
+    std::string socketPath;
+    std::string cacheDirectory;
+    WorleyParams volumeParams;
+    volumeParams.size = TEXTURE_SIZE;
+    volumeParams.points = WORLEY_POINTS;
+    bool normalize = false;
+    std::vector<std::string> distanceOutputs, offsetOutputs;
+    float normalizePercentile = 0.0f;
+    std::uintmax_t cacheMegabytes = 256;
+    int i = 1;
+    try
     {
-        std::string arg(argv[1]);
-        preview = arg == "--preview";
+        for (; i < argc; i++)
+        {
+            std::string arg(argv[i]);
+            if (arg == "--preview")
+            {
+                preview = true;
+            }
+            else if (arg == "--benchmark")
+            {
+                return runWorleyBenchmark() ? 0 : -1;
+            }
+            else if (arg == "--batch" && i + 1 < argc)
+            {
+                batchFile = argv[++i];
+            }
+            else if (arg == "--serve" && i + 1 < argc)
+            {
+                socketPath = argv[++i];
+            }
+            else if (arg == "--curve" && i + 1 < argc)
+            {
+                if (!parseRemapCurve(argv[++i], volumeParams))
+                {
+                    std::cout << "\tError: Unknown curve " << argv[i] << std::endl;
+                    return -1;
+                }
+            }
+            else if (arg == "--hdr")
+            {
+                distanceOutputs.push_back("worleyDistances.hdr");
+            }
+            else if (arg == "--raw")
+            {
+                distanceOutputs.push_back("worleyDistances.f32");
+            }
+            else if (arg == "--cells")
+            {
+                cells = true;
+            }
+            else if (arg == "--offsets")
+            {
+                offsetOutputs.push_back("worleyOffsets.f32");
+            }
+            else if (arg == "--poisson")
+            {
+                volumeParams.distribution = WorleyPointDistribution::Poisson;
+            }
+            else if (arg == "--normalize")
+            {
+                normalize = true;
+            }
+            else if (arg == "--normalize-percentile" && i + 1 < argc)
+            {
+                normalize = true;
+                normalizePercentile = parseFloat(argv[++i]);
+            }
+            else if (arg == "--cache" && i + 1 < argc)
+            {
+                cacheDirectory = argv[++i];
+            }
+            else if (arg == "--cache-size" && i + 1 < argc)
+            {
+                cacheMegabytes = parseUnsigned(argv[++i], UINT32_MAX);
+            }
+            else if (arg == "--no-uring")
+            {
+                uring = false;
+            }
+            else if (arg == "--numa")
+            {
+                numa = true;
+            }
+            else if (arg == "--seed" && i + 1 < argc)
+            {
+                fixedSeed = true;
+                volumeSeed = parseUnsigned(argv[++i], UINT32_MAX);
+            }
+            else if (arg == "--processes" && i + 1 < argc)
+            {
+                numProcesses = std::max(1u, parseUnsigned(argv[++i], TEXTURE_SLICES));
+            }
+            else if (arg == "--frames" && i + 1 < argc)
+            {
+                volumeParams.frames = std::max(1u, parseUnsigned(argv[++i], UINT32_MAX));
+            }
+            else if (arg == "--volume" && i + 1 < argc)
+            {
+                cubeSize = parseUnsigned(argv[++i], MAX_VOLUME_SIZE);
+            }
+            else if (arg == "--brick" && i + 1 < argc)
+            {
+                brickSlices = std::max(1u, parseUnsigned(argv[++i], UINT32_MAX));
+            }
+            else if (arg == "--slices" && i + 1 < argc)
+            {
+                if (!parseSliceRange(argv[++i], volumeRange))
+                {
+                    std::cout << "\tError: --slices takes first:end within 0:" << TEXTURE_SLICES << ", not " << argv[i] << std::endl;
+                    return -1;
+                }
+            }
+            else if (arg == "--region" && i + 1 < argc)
+            {
+                if (!parseSliceRegion(argv[++i], volumeRange))
+                {
+                    std::cout << "\tError: --region takes x,y,width,height within a " << TEXTURE_SIZE << " pixel slice, not " << argv[i] << std::endl;
+                    return -1;
+                }
+            }
+            else if (arg == "--mips")
+            {
+                mips = true;
+            }
+            else if (arg == "--mips-kaiser")
+            {
+                mips = true;
+                mipFilter = MipFilter::Kaiser;
+            }
+        }
+    }
+    catch (const std::logic_error &)
+    {
+        // std::invalid_argument or std::out_of_range, thrown with i on the value
+        std::cout << "\tError: " << argv[i] << " is not a valid value for " << argv[i - 1] << std::endl;
+        return -1;
+    }
+
+    // serve requests until told to quit, the pool stays warm between them
+    if (!socketPath.empty())
+    {
+        ThreadPool pool(std::thread::hardware_concurrency());
+        return runWorleyServer(socketPath, pool) ? 0 : -1;
+    }
+
+    // run the batch headless, one pool for every job
+    if (!batchFile.empty())
+    {
+        std::vector<WorleyJob> jobs;
+        if (!loadWorleyJobs(batchFile, jobs))
+        {
+            return -1;
+        }
+
+        ThreadPool pool(std::thread::hardware_concurrency());
+        std::cout << "Running " << jobs.size() << " jobs on " << pool.size() << " threads" << std::endl;
+        std::unique_ptr<ResultCache> cache;
+        if (!cacheDirectory.empty())
+        {
+            cache.reset(new ResultCache(cacheDirectory, cacheMegabytes * 1024 * 1024));
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        FileWriter writer(pool.size(), PIPELINE_QUEUE_SLICES, uring);
+        std::cout << "Writing files through " << (writer.usesUring() ? "io_uring" : "a thread pool") << std::endl;
+        std::uint64_t allocations = getAllocationCount();
+        unsigned int failed = runWorleyJobs(jobs, pool, writer, cache.get());
+        allocations = getAllocationCount() - allocations;
+        auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
+        std::cout << "Finished " << jobs.size() - failed << "/" << jobs.size() << " jobs in " << elapsed.count() << " ms" << std::endl;
+        std::cout << "Memory: " << allocations << " allocations, " << getPeakMemory() / (1024 * 1024) << " MiB peak" << std::endl;
+        if (cache)
+        {
+            ResultCacheStats stats = cache->stats();
+            std::cout << "Cache: " << stats.hits << " hits, " << stats.misses << " misses, " << stats.evictions << " evictions" << std::endl;
+        }
+        return failed == 0 ? 0 : -1;
+    }
+
+    // write a volume of any size brick by brick, headless
+    if (cubeSize > 0)
+    {
+        if (!volumeRange.isWhole() || volumeParams.frames > 1 || numProcesses > 1 || cells || mips || !distanceOutputs.empty() || !offsetOutputs.empty())
+        {
+            std::cout << "\tError: --volume only writes the whole volume of noise bytes" << std::endl;
+            return -1;
+        }
+
+        // the same feature size as the spritesheet slices, so a bigger volume gets more points instead of bigger cells
+        WorleyParams params = volumeParams;
+        params.size = cubeSize;
+        params.points = std::max(1u, (unsigned int)((std::uint64_t)WORLEY_POINTS * cubeSize * cubeSize / (TEXTURE_SIZE * TEXTURE_SIZE)));
+        if (!fixedSeed)
+        {
+            volumeSeed = randomDevice();
+        }
+        std::cout << "Volume seed " << volumeSeed << std::endl;
+
+        brickSlices = std::min(brickSlices, cubeSize);
+        if ((std::uint64_t)brickSlices * cubeSize * cubeSize > MAX_BRICK_BYTES)
+        {
+            std::cout << "\tError: a brick of " << brickSlices << " slices of " << cubeSize << "^2 bytes is over "
+                      << MAX_BRICK_BYTES / (1024 * 1024) << " MiB, take a smaller --brick" << std::endl;
+            return -1;
+        }
+        ThreadPool pool(std::thread::hardware_concurrency());
+        std::cout << "Generating a " << cubeSize << "^3 volume in bricks of " << brickSlices << " slices ("
+                  << (std::uint64_t)brickSlices * cubeSize * cubeSize / (1024 * 1024) << " MiB) on " << pool.size() << " threads" << std::endl;
+        auto start = std::chrono::steady_clock::now();
+        if (!writeWorleyVolume("worleyVolume.raw", params, volumeSeed, brickSlices, normalize, normalizePercentile, pool))
+        {
+            std::cout << "\tError: Could not write worleyVolume.raw" << std::endl;
+            return -1;
+        }
+        auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
+        std::cout << "Generated and wrote " << cubeSize << " slices in " << elapsed.count() << " ms, " << getPeakMemory() / (1024 * 1024) << " MiB peak memory" << std::endl;
+        return 0;
     }
 
     // generate the preview
     if (preview)
     {
         std::cout << "Generating preview" << std::endl;
-        std::vector<sf::Uint8> worleyNoise = generateTiledWorleyNoise(randomDevice);
-        
+        WorleyParams params;
+        params.seed = randomDevice();
+        params.size = TEXTURE_SIZE;
+        params.points = WORLEY_POINTS;
+        PreviewGenerator generator;
+        generator.request(params);
+
+        std::vector<sf::Uint8> worleyNoise;
         sf::Texture texture;
-        texture.create(TILED_TEXTURE_SIZE, TILED_TEXTURE_SIZE);
-        texture.update(worleyNoise.data());
+        texture.create(TEXTURE_SIZE, TEXTURE_SIZE);
 
         const unsigned int PREVIEW_SCALE = 4;
         const unsigned int PREVIEW_SIZE = TEXTURE_SIZE * PREVIEW_SCALE;
-        sf::IntRect previewRect(TEXTURE_SIZE, TEXTURE_SIZE, TEXTURE_SIZE, TEXTURE_SIZE);
-        sf::Sprite preview(texture, previewRect);
+        sf::Sprite preview(texture);
         preview.setScale(PREVIEW_SCALE, PREVIEW_SCALE);
 
         std::cout << "Initializing window" << std::endl;
-        sf::RenderWindow window(sf::VideoMode(PREVIEW_SIZE, PREVIEW_SIZE), "Tileable Worley Noise (Preview)");
+        sf::RenderWindow window(sf::VideoMode(PREVIEW_SIZE, PREVIEW_SIZE), getPreviewTitle(params));
+        window.setFramerateLimit(60);
         while(window.isOpen())
         {
             sf::Event event;
@@ -168,12 +880,65 @@ int main(int argc, char *argv[])
                     window.close();
                 }
 
-                if (event.type == sf::Event::KeyReleased && event.key.code == sf::Keyboard::Enter)
+                // tweak the parameters, only the affected parts get regenerated
+                WorleyParams previous = params;
+                if (event.type == sf::Event::KeyReleased)
+                {
+                    switch (event.key.code)
+                    {
+                    case sf::Keyboard::Enter:
+                        params.seed = randomDevice();
+                        break;
+                    case sf::Keyboard::Up:
+                        params.points++;
+                        break;
+                    case sf::Keyboard::Down:
+                        params.points = std::max(1u, params.points - 1);
+                        break;
+                    case sf::Keyboard::Right:
+                        params.octaves = std::min(MAX_WORLEY_OCTAVES, params.octaves + 1);
+                        break;
+                    case sf::Keyboard::Left:
+                        params.octaves = std::max(1u, params.octaves - 1);
+                        break;
+                    case sf::Keyboard::M:
+                        params.mode = (WorleyDistanceMode)(((int)params.mode + 1) % 4);
+                        break;
+                    case sf::Keyboard::D:
+                        params.metric = (WorleyMetric)(((int)params.metric + 1) % 4);
+                        break;
+                    case sf::Keyboard::P:
+                        params.distribution = params.distribution == WorleyPointDistribution::Uniform ? WorleyPointDistribution::Poisson : WorleyPointDistribution::Uniform;
+                        break;
+                    case sf::Keyboard::C:
+                        params.curve = (WorleyRemapCurve)(((int)params.curve + 1) % 4);
+                        break;
+                    default:
+                        break;
+                    }
+                }
+                if (event.type == sf::Event::MouseWheelScrolled)
+                {
+                    int points = params.points + (int)event.mouseWheelScroll.delta;
+                    params.points = std::max(1, points);
+                }
+                if (event.type == sf::Event::MouseButtonReleased)
                 {
-                    worleyNoise = generateTiledWorleyNoise(randomDevice);
-                    texture.update(worleyNoise.data());
-                    preview.setTexture(texture);
+                    params.mode = (WorleyDistanceMode)(((int)params.mode + 1) % 4);
                 }
+
+                if (params != previous)
+                {
+                    window.setTitle(getPreviewTitle(params));
+                    generator.request(params);
+                }
+            }
+
+            // swap in the new noise once the workers are done with it
+            if (generator.takeResult(worleyNoise))
+            {
+                texture.update(worleyNoise.data());
+                preview.setTexture(texture);
             }
 
             window.draw(preview);
@@ -183,41 +948,179 @@ int main(int argc, char *argv[])
         return 0;
     }
 
+    // the atlases and the volume mips mix every slice into one file
+    if (!volumeRange.isWhole() && (cells || mips || std::count(distanceOutputs.begin(), distanceOutputs.end(), "worleyDistances.hdr") > 0))
+    {
+        std::cout << "\tError: --cells, --hdr and --mips need the whole volume, not --slices or --region" << std::endl;
+        return -1;
+    }
+
+    // no more processes than slices, before anything (the checks, the normalize pass) depends on their number
+    numProcesses = std::min<unsigned int>(numProcesses, volumeRange.sliceCount);
+
+    // the float outputs and the cells need the distance fields, which stay in the worker processes
+    if (numProcesses > 1 && (cells || !distanceOutputs.empty() || !offsetOutputs.empty() || numa))
+    {
+        std::cout << "\tError: --processes only writes the slices and the mips, without --numa" << std::endl;
+        return -1;
+    }
+
+    // a time loop only writes its frames of the slices
+    if (volumeParams.frames > 1 && (cells || mips || !distanceOutputs.empty() || !offsetOutputs.empty() || numProcesses > 1))
+    {
+        std::cout << "\tError: --frames only writes the slices of every frame, in a single process" << std::endl;
+        return -1;
+    }
+
     // create the noise spritesheet
-    const unsigned int numThreads = std::min(std::thread::hardware_concurrency(), TEXTURE_SLICES);
-    unsigned int slicesPerThread = TEXTURE_SLICES / numThreads;
-    std::cout << "Using " << numThreads << " threads to generate " << TEXTURE_SLICES << " noises" << std::endl;
-    std::vector<std::thread> threads;
-    for (int i = 0; i < numThreads; i++)
+    const unsigned int noises = volumeRange.sliceCount * volumeParams.frames;
+    const unsigned int numThreads = std::max(1u, std::min(std::thread::hardware_concurrency(), noises));
+    std::cout << "Using " << numThreads << " threads to generate " << noises << " noises" << std::endl;
+    if (numa)
     {
-        int threadSliceIndex = i * slicesPerThread;
-        int threadSlices = (i == numThreads - 1) ? TEXTURE_SLICES - threadSliceIndex : slicesPerThread;
-        threads.emplace_back(generateWorleyNoiseSlices, threadSliceIndex, threadSlices, std::ref(randomDevice));
+        sliceThreadCpus = getNumaThreadCpus(numThreads);
+        std::cout << "Pinning them over " << getNumaNodeCpus().size() << " NUMA nodes" << std::endl;
     }
-    for (std::thread &thread : threads)
+    // every slice seed follows from the volume seed, so a run with --slices or --region and the same --seed writes
+    // exactly that part of the whole volume
+    if (!fixedSeed)
     {
-        if (thread.joinable())
+        volumeSeed = randomDevice();
+    }
+    std::cout << "Volume seed " << volumeSeed << std::endl;
+    std::mt19937 sliceSeeds(volumeSeed);
+    std::vector<WorleyParams> sliceParams(TEXTURE_SLICES, volumeParams);
+    for (WorleyParams &params : sliceParams)
+    {
+        params.seed = sliceSeeds();
+    }
+
+    // Only the passes after generation need a generator per slice: the normalized run re-tones the fields it kept
+    // instead of generating them again, the atlases and float outputs read them. Otherwise every slice thread has one.
+    const bool keepFields = normalize || cells || !distanceOutputs.empty() || !offsetOutputs.empty();
+    std::vector<WorleyGenerator> generators(keepFields ? TEXTURE_SLICES : 0);
+    worleyTiles.reset((sf::Uint8 *)std::aligned_alloc(TILES_ALIGNMENT, TEXTURE_SLICES * TEXTURE_PIXELS));
+    if (!worleyTiles)
+    {
+        std::cout << "\tError: Could not allocate the slices" << std::endl;
+        return -1;
+    }
+
+    // one tone range for the whole volume, the slices only get re-toned with it below; partial runs still go over
+    // every slice here so they get the same range
+    if (normalize && numProcesses == 1)
+    {
+        std::vector<unsigned int> histogram;
+        runSliceThreads(numThreads, 0, TEXTURE_SLICES, [&](int index, int count)
         {
-            thread.join();
+            generateWorleyNoiseSlices(index, count, generators, sliceParams, &histogram);
+        });
+
+        findWorleyToneRange(histogram, TEXTURE_SIZE, normalizePercentile, volumeParams.rangeMin, volumeParams.rangeMax);
+        std::cout << "Normalized distances to [" << volumeParams.rangeMin << ", " << volumeParams.rangeMax << "]" << std::endl;
+        for (WorleyParams &params : sliceParams)
+        {
+            params.rangeMin = volumeParams.rangeMin;
+            params.rangeMax = volumeParams.rangeMax;
         }
     }
 
+    // the slice files of every frame are the result, no spritesheet
+    if (volumeParams.frames > 1)
+    {
+        std::cout << "Generating " << volumeParams.frames << " frames of the time loop" << std::endl;
+        FileWriter writer(numThreads, PIPELINE_QUEUE_SLICES, uring);
+        auto start = std::chrono::steady_clock::now();
+        if (!writeWorleyFrames(sliceParams, numThreads, writer))
+        {
+            std::cout << "\tError: Could not write the frames" << std::endl;
+            return -1;
+        }
+        auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
+        std::cout << "Generated and wrote " << noises << " slices in " << elapsed.count() << " ms" << std::endl;
+        return 0;
+    }
+
     std::cout << "Generating spritesheet" << std::endl;
     std::vector<std::string> spritesheet;
-    sf::IntRect spritesheetRect(TEXTURE_SIZE, TEXTURE_SIZE, TEXTURE_SIZE, TEXTURE_SIZE);
-    const unsigned int TILED_TEXTURE_PIXELS = TILED_TEXTURE_SIZE * TILED_TEXTURE_SIZE * 4;
     for (int i = 0; i < TEXTURE_SLICES; i++)
     {
-        std::vector<sf::Uint8> slicePixels = getWorleyNoiseSlice(i);
-        if (slicePixels.empty())
+        spritesheet.push_back("worleySlice_" + std::to_string(i) + ".bmp");
+    }
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::vector<std::uint8_t>> shardFiles;
+    if (numProcesses > 1)
+    {
+        std::cout << "Splitting the slices over " << numProcesses << " processes" << std::endl;
+        if (!generateWorleySliceFilesSharded(sliceParams, numProcesses, normalize, normalizePercentile, spritesheet, shardFiles))
+        {
+            return -1;
+        }
+    }
+
+    // the writer's threads start only now, the worker processes are done
+    FileWriter writer(numThreads, PIPELINE_QUEUE_SLICES, uring);
+    std::cout << "Writing files through " << (writer.usesUring() ? "io_uring" : "a thread pool") << std::endl;
+    bool written;
+    if (numProcesses > 1)
+    {
+        for (int i = volumeRange.firstSlice; i < volumeRange.firstSlice + volumeRange.sliceCount; i++)
+        {
+            writer.submit(spritesheet[i], std::move(shardFiles[i]));
+        }
+        written = writer.finish() == 0;
+    }
+    else
+    {
+        written = writeWorleySliceFiles(generators, sliceParams, numThreads, spritesheet, writer);
+    }
+    if (!written)
+    {
+        std::cout << "\tError: Could not write the slices" << std::endl;
+        return -1;
+    }
+    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
+    std::cout << "Generated and wrote " << volumeRange.sliceCount << " slices in " << elapsed.count() << " ms, " << getPeakMemory() / (1024 * 1024) << " MiB peak memory" << std::endl;
+
+    for (const std::string &filename : distanceOutputs)
+    {
+        std::cout << "Writing distances to " << filename << std::endl;
+        if (!writeWorleyFloats(filename, generators, &WorleyGenerator::renderDistances, numThreads))
+        {
+            std::cout << "\tError: Could not write " << filename << std::endl;
+            return -1;
+        }
+    }
+
+    for (const std::string &filename : offsetOutputs)
+    {
+        std::cout << "Writing closest point offsets to " << filename << std::endl;
+        if (!writeWorleyFloats(filename, generators, &WorleyGenerator::renderOffsets, numThreads))
         {
-            std::cout << "\tError: Slice #" << i << " is empty.";
+            std::cout << "\tError: Could not write " << filename << std::endl;
             return -1;
         }
+    }
+
+    if (cells)
+    {
+        std::cout << "Writing cells to worleyCells.png" << std::endl;
+        writeWorleyCells("worleyCells.png", generators, numThreads);
+    }
 
-        std::string filename = "worleySlice_" + std::to_string(i) + ".bmp";
-        stbi_write_bmp(filename.c_str(), TILED_TEXTURE_SIZE, TILED_TEXTURE_SIZE, 4, slicePixels.data());
-        spritesheet.push_back(filename);
+    sf::IntRect spritesheetRect(0, 0, volumeRange.region.width, volumeRange.region.height);
+    if (mips)
+    {
+        std::cout << "Generating mip chains" << std::endl;
+        writeWorleyMipChains(mipFilter, numThreads);
+    }
+
+    // partial and multi process runs are meant to be put together or checked later, so they keep their slice files
+    // and don't open a window
+    if (!volumeRange.isWhole() || numProcesses > 1)
+    {
+        std::cout << "Kept the slice files" << std::endl;
+        return 0;
     }
 
     std::cout << "Initializing window" << std::endl;
@@ -241,14 +1144,14 @@ int main(int argc, char *argv[])
         window.clear();
 
         float sliceX, sliceY;
-        for (int i = 0; i < TEXTURE_SLICES; i++)
+        for (int i = volumeRange.firstSlice; i < volumeRange.firstSlice + volumeRange.sliceCount; i++)
         {
             sf::Texture worleySliceTexture;
             worleySliceTexture.loadFromFile(spritesheet.at(i)); // lets assume this always works :D
             sf::Sprite worleySlice(worleySliceTexture, spritesheetRect);
             sliceX = i % TEXTURE_SLICE_ROW;
             sliceY = std::floor(i / TEXTURE_SLICE_ROW);
-            worleySlice.move(sliceX * TEXTURE_SIZE, sliceY * TEXTURE_SIZE);
+            worleySlice.move(sliceX * TEXTURE_SIZE + volumeRange.region.left, sliceY * TEXTURE_SIZE + volumeRange.region.top);
             window.draw(worleySlice);
         }
 
@@ -0,0 +1,215 @@
+#include "mipmap.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <thread>
+
+// output rows filtered per band, keeps the horizontal pass hot in cache for large slices
+const unsigned int MIP_BLOCK_ROWS = 16;
+
+struct MipKernel
+{
+    int first;                  // offset of the first tap relative to 2 * output index
+    std::vector<float> weights; // normalized tap weights
+};
+
+static double besselI0(double x)
+{
+    double sum = 1.0, term = 1.0;
+    for (int k = 1; k < 32; k++)
+    {
+        term *= (x / (2.0 * k)) * (x / (2.0 * k));
+        sum += term;
+    }
+    return sum;
+}
+
+static MipKernel createMipKernel(MipFilter filter)
+{
+    if (filter == MipFilter::Box)
+    {
+        return {0, {0.5f, 0.5f}};
+    }
+
+    // 2x decimation lowpass centered between the two source texels, windowed to 8 taps
+    const double PI = 3.14159265358979323846;
+    const double BETA = 4.0;
+    const double RADIUS = 4.0;
+    MipKernel kernel{-3, {}};
+    double sum = 0.0;
+    std::vector<double> weights;
+    for (int k = -3; k <= 4; k++)
+    {
+        double t = k - 0.5;
+        double x = PI * t * 0.5;
+        double sinc = std::sin(x) / x;
+        double r = t / RADIUS;
+        double window = besselI0(BETA * std::sqrt(std::max(0.0, 1.0 - r * r))) / besselI0(BETA);
+        weights.push_back(sinc * window);
+        sum += weights.back();
+    }
+    for (double weight : weights)
+    {
+        kernel.weights.push_back(weight / sum);
+    }
+
+    return kernel;
+}
+
+static unsigned int wrapIndex(int value, unsigned int size)
+{
+    int wrapped = value % (int)size;
+    return wrapped < 0 ? wrapped + size : wrapped;
+}
+
+static std::uint8_t toMipTexel(float value)
+{
+    return (std::uint8_t)std::min(255L, std::max(0L, std::lround(value)));
+}
+
+static void parallelFor(unsigned int count, unsigned int numThreads, const std::function<void(unsigned int)> &job)
+{
+    numThreads = std::max(1u, std::min(numThreads, count));
+    unsigned int itemsPerThread = count / numThreads;
+    std::vector<std::thread> threads;
+    for (unsigned int i = 0; i < numThreads; i++)
+    {
+        unsigned int first = i * itemsPerThread;
+        unsigned int last = (i == numThreads - 1) ? count : first + itemsPerThread;
+        threads.emplace_back([first, last, &job]()
+        {
+            for (unsigned int item = first; item < last; item++)
+            {
+                job(item);
+            }
+        });
+    }
+    for (std::thread &thread : threads)
+    {
+        thread.join();
+    }
+}
+
+static MipSlice downsampleSlice(const MipSlice &source, unsigned int size, const MipKernel &kernel)
+{
+    const unsigned int half = std::max(1u, size / 2);
+    const unsigned int taps = kernel.weights.size();
+    MipSlice result(half * half);
+
+    // horizontally filtered source rows for the current band of output rows
+    std::vector<float> band((2 * MIP_BLOCK_ROWS + taps) * half);
+    for (unsigned int bandStart = 0; bandStart < half; bandStart += MIP_BLOCK_ROWS)
+    {
+        unsigned int bandRows = std::min(MIP_BLOCK_ROWS, half - bandStart);
+        int firstRow = 2 * bandStart + kernel.first;
+        unsigned int sourceRows = 2 * (bandRows - 1) + taps;
+
+        // horizontal pass
+        for (unsigned int row = 0; row < sourceRows; row++)
+        {
+            const std::uint8_t *sourceRow = &source[wrapIndex(firstRow + row, size) * size];
+            float *bandRow = &band[row * half];
+            for (unsigned int x = 0; x < half; x++)
+            {
+                float value = 0.0f;
+                int firstColumn = 2 * x + kernel.first;
+                for (unsigned int k = 0; k < taps; k++)
+                {
+                    value += kernel.weights[k] * sourceRow[wrapIndex(firstColumn + k, size)];
+                }
+                bandRow[x] = value;
+            }
+        }
+
+        // vertical pass
+        for (unsigned int y = 0; y < bandRows; y++)
+        {
+            std::uint8_t *resultRow = &result[(bandStart + y) * half];
+            for (unsigned int x = 0; x < half; x++)
+            {
+                float value = 0.0f;
+                for (unsigned int k = 0; k < taps; k++)
+                {
+                    value += kernel.weights[k] * band[(2 * y + k) * half + x];
+                }
+                resultRow[x] = toMipTexel(value);
+            }
+        }
+    }
+
+    return result;
+}
+
+std::vector<std::vector<MipSlice>> generateSliceMipChains(const std::vector<MipSlice> &slices, unsigned int size, MipFilter filter, unsigned int numThreads)
+{
+    const MipKernel kernel = createMipKernel(filter);
+    std::vector<std::vector<MipSlice>> chains(slices.size());
+    parallelFor(slices.size(), numThreads, [&](unsigned int i)
+    {
+        std::vector<MipSlice> &chain = chains[i];
+        chain.push_back(slices[i]);
+        for (unsigned int levelSize = size; levelSize > 1; levelSize /= 2)
+        {
+            chain.push_back(downsampleSlice(chain.back(), levelSize, kernel));
+        }
+    });
+
+    return chains;
+}
+
+std::vector<MipVolumeLevel> generateVolumeMipChain(const std::vector<MipSlice> &slices, unsigned int size, MipFilter filter, unsigned int numThreads)
+{
+    const MipKernel kernel = createMipKernel(filter);
+    const unsigned int taps = kernel.weights.size();
+    std::vector<MipVolumeLevel> levels;
+    levels.push_back({size, slices});
+    while (levels.back().size > 1 || levels.back().slices.size() > 1)
+    {
+        const MipVolumeLevel &previous = levels.back();
+
+        // downsample every slice on x and y
+        MipVolumeLevel planar{previous.size, previous.slices};
+        if (previous.size > 1)
+        {
+            planar.size = previous.size / 2;
+            parallelFor(previous.slices.size(), numThreads, [&](unsigned int i)
+            {
+                planar.slices[i] = downsampleSlice(previous.slices[i], previous.size, kernel);
+            });
+        }
+
+        // downsample the stack on z
+        const unsigned int depth = planar.slices.size();
+        if (depth == 1)
+        {
+            levels.push_back(planar);
+            continue;
+        }
+
+        const unsigned int pixels = planar.size * planar.size;
+        MipVolumeLevel level{planar.size, std::vector<MipSlice>(depth / 2)};
+        parallelFor(depth / 2, numThreads, [&](unsigned int z)
+        {
+            std::vector<float> accumulated(pixels, 0.0f);
+            for (unsigned int k = 0; k < taps; k++)
+            {
+                const MipSlice &source = planar.slices[wrapIndex(2 * z + kernel.first + k, depth)];
+                for (unsigned int i = 0; i < pixels; i++)
+                {
+                    accumulated[i] += kernel.weights[k] * source[i];
+                }
+            }
+
+            MipSlice &slice = level.slices[z];
+            slice.resize(pixels);
+            for (unsigned int i = 0; i < pixels; i++)
+            {
+                slice[i] = toMipTexel(accumulated[i]);
+            }
+        });
+        levels.push_back(level);
+    }
+
+    return levels;
+}
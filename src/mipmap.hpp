@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+// single channel, square slice buffer (size * size bytes)
+typedef std::vector<std::uint8_t> MipSlice;
+
+// one mip level of a volume: a stack of equally sized slices
+struct MipVolumeLevel
+{
+    unsigned int size;
+    std::vector<MipSlice> slices;
+};
+
+enum class MipFilter
+{
+    Box,   // 2x2 average, cheapest
+    Kaiser // 8 tap Kaiser windowed sinc, sharper low mips
+};
+
+// Generates the full 2D mip chain (level 0 included, down to 1x1) for every slice.
+// Sampling wraps around the slice edges, so every level stays tileable.
+// Slices are split between numThreads worker threads.
+std::vector<std::vector<MipSlice>> generateSliceMipChains(const std::vector<MipSlice> &slices, unsigned int size, MipFilter filter, unsigned int numThreads);
+
+// Generates the full 3D mip chain (level 0 included) for the slice stack, wrapping on all three axes.
+// Every axis is halved per level until it reaches 1.
+std::vector<MipVolumeLevel> generateVolumeMipChain(const std::vector<MipSlice> &slices, unsigned int size, MipFilter filter, unsigned int numThreads);
@@ -0,0 +1,147 @@
+#include "numa.hpp"
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+
+#include <pthread.h>
+#include <sched.h>
+
+// parses a sysfs cpu list like "0-3,8-11"
+static std::vector<unsigned int> parseCpuList(const std::string &list)
+{
+    std::vector<unsigned int> cpus;
+    std::stringstream stream(list);
+    std::string range;
+    while (std::getline(stream, range, ','))
+    {
+        if (range.empty() || range == "\n")
+        {
+            continue;
+        }
+
+        std::size_t dash = range.find('-');
+        unsigned int first = std::stoul(range.substr(0, dash));
+        unsigned int last = dash == std::string::npos ? first : std::stoul(range.substr(dash + 1));
+        for (unsigned int cpu = first; cpu <= last; cpu++)
+        {
+            cpus.push_back(cpu);
+        }
+    }
+    return cpus;
+}
+
+// the cpus the process may run on (taskset, cgroup cpusets), every online one when that can't be read
+static std::vector<unsigned int> getAllowedCpus()
+{
+    std::vector<unsigned int> cpus;
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if (sched_getaffinity(0, sizeof(set), &set) == 0)
+    {
+        for (unsigned int cpu = 0; cpu < CPU_SETSIZE; cpu++)
+        {
+            if (CPU_ISSET(cpu, &set))
+            {
+                cpus.push_back(cpu);
+            }
+        }
+    }
+
+    if (cpus.empty())
+    {
+        for (unsigned int cpu = 0; cpu < std::max(1u, std::thread::hardware_concurrency()); cpu++)
+        {
+            cpus.push_back(cpu);
+        }
+    }
+    return cpus;
+}
+
+std::vector<std::vector<unsigned int>> getNumaNodeCpus()
+{
+    const std::vector<unsigned int> allowed = getAllowedCpus();
+    std::vector<std::vector<unsigned int>> nodes;
+    std::ifstream online("/sys/devices/system/node/online");
+    std::string nodeList;
+    if (online >> nodeList)
+    {
+        for (unsigned int node : parseCpuList(nodeList))
+        {
+            std::ifstream file("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist");
+            std::string cpuList;
+            if (file >> cpuList)
+            {
+                // only the ones the process is allowed on, pinning to the others would fail
+                std::vector<unsigned int> cpus;
+                for (unsigned int cpu : parseCpuList(cpuList))
+                {
+                    if (std::binary_search(allowed.begin(), allowed.end(), cpu))
+                    {
+                        cpus.push_back(cpu);
+                    }
+                }
+                if (!cpus.empty())
+                {
+                    nodes.push_back(cpus);
+                }
+            }
+        }
+    }
+
+    if (nodes.empty())
+    {
+        nodes.push_back(allowed);
+    }
+    return nodes;
+}
+
+std::vector<unsigned int> getNumaThreadCpus(unsigned int numThreads)
+{
+    const std::vector<std::vector<unsigned int>> nodes = getNumaNodeCpus();
+    unsigned int totalCpus = 0;
+    for (const std::vector<unsigned int> &cpus : nodes)
+    {
+        totalCpus += cpus.size();
+    }
+
+    // every node gets its share of the threads, the rounding leftovers go to the first nodes
+    std::vector<unsigned int> nodeThreads(nodes.size());
+    unsigned int assigned = 0;
+    for (int i = 0; i < nodes.size(); i++)
+    {
+        nodeThreads[i] = numThreads * nodes[i].size() / totalCpus;
+        assigned += nodeThreads[i];
+    }
+    for (int i = 0; assigned < numThreads; i = (i + 1) % nodes.size())
+    {
+        nodeThreads[i]++;
+        assigned++;
+    }
+
+    // more threads than cpus wrap around the node's cpus
+    std::vector<unsigned int> threadCpus;
+    for (int i = 0; i < nodes.size(); i++)
+    {
+        for (unsigned int thread = 0; thread < nodeThreads[i]; thread++)
+        {
+            threadCpus.push_back(nodes[i][thread % nodes[i].size()]);
+        }
+    }
+    return threadCpus;
+}
+
+bool pinThreadToCpu(unsigned int cpu)
+{
+    if (cpu >= CPU_SETSIZE)
+    {
+        return false;
+    }
+
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+}
@@ -0,0 +1,14 @@
+#pragma once
+
+#include <vector>
+
+// The cpus of every NUMA node from sysfs, only those the process is allowed to run on (sched_getaffinity), and only the
+// nodes left with any. A single node with every allowed cpu when there is no NUMA info.
+std::vector<std::vector<unsigned int>> getNumaNodeCpus();
+
+// Picks a cpu for each of numThreads threads, spread over the nodes by their cpu counts and ordered node by node, so
+// threads handed consecutive work ranges keep every range on one node.
+std::vector<unsigned int> getNumaThreadCpus(unsigned int numThreads);
+
+// pins the calling thread to cpu, false when the system refused
+bool pinThreadToCpu(unsigned int cpu);
@@ -0,0 +1,227 @@
+#include "poisson.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+// how many points of radius r the sampler fits in a unit area, on average
+const float POISSON_DENSITY = 1.0f;
+
+// empty grid cells hold a point so far away it never conflicts, which keeps the neighbour test branch free
+const float POISSON_EMPTY_CELL = -1.0e6f;
+
+static float wrapCoordinate(float value, float size)
+{
+    // a tiny negative value plus the size rounds to the size itself
+    if (value < 0.0f)
+    {
+        value += size;
+    }
+    return value >= size ? value - size : value;
+}
+
+void generatePoissonPoints(std::mt19937 &rand, unsigned int size, float radius, std::vector<float> &xs, std::vector<float> &ys, PoissonScratch &scratch)
+{
+    // Candidates sit on a circle just past radius around a point, so the points that can block one are less than
+    // radius plus that away. The background grid has at most one point per cell and its cells have to tile the torus
+    // exactly; it is padded with that reach on every side, holding the wrapped copies of the points, so gathering
+    // the neighbours reads plain rows without wrapping anything.
+    const float candidateDistance = getPoissonCoverage(radius);
+    const float candidateSquared = candidateDistance * candidateDistance, radiusSquared = radius * radius;
+    const float blockingSquared = (radius + candidateDistance) * (radius + candidateDistance);
+    const int gridSize = std::max(1, (int)std::ceil(size * std::sqrt(2.0f) / radius));
+    const float inverseCellSize = gridSize / (float)size;
+    const int reach = (int)std::ceil((radius + candidateDistance) * inverseCellSize);
+    const int paddedSize = gridSize + 2 * reach, rowCells = 2 * reach + 1;
+    const float tileSize = size;
+    std::vector<float> &gridXs = scratch.gridXs, &gridYs = scratch.gridYs;
+    std::vector<float> &pointXs = scratch.pointXs, &pointYs = scratch.pointYs;
+    std::vector<float> &nearXs = scratch.nearXs, &nearYs = scratch.nearYs, &endXs = scratch.endXs, &endYs = scratch.endYs;
+    std::vector<int> &rowNear = scratch.rowNear;
+    gridXs.assign(paddedSize * paddedSize, POISSON_EMPTY_CELL);
+    gridYs.assign(paddedSize * paddedSize, POISSON_EMPTY_CELL);
+    pointXs.clear();
+    pointYs.clear();
+    // the point count of any seed fits, so the buffers stop growing after the first run
+    const std::size_t maxPoints = getPoissonMaxPoints(size, radius);
+    pointXs.reserve(maxPoints);
+    pointYs.reserve(maxPoints);
+    xs.reserve(xs.size() + maxPoints);
+    ys.reserve(ys.size() + maxPoints);
+    // On tiles that don't hold twice the reach, the wrapped copies of a point the sweep adds can block the sweep
+    // too. The near list holds every cell around a point and the few points its own sweep adds (they are radius
+    // apart on its circle), with those copies.
+    const int copies = tileSize < 2.0f * (radius + candidateDistance) ? 2 : 0;
+    const int nearCapacity = rowCells * rowCells + 6 * (2 * copies + 1) * (2 * copies + 1);
+    nearXs.resize(nearCapacity);
+    nearYs.resize(nearCapacity);
+    endXs.resize(nearCapacity);
+    endYs.resize(nearCapacity);
+    rowNear.resize(rowCells);
+
+    // one draw from the caller's engine seeds a cheap local one (splitmix64) for the start directions
+    std::uint64_t state = (std::uint64_t)rand() << 32 | rand();
+    auto next = [&state]()
+    {
+        state += 0x9E3779B97F4A7C15ull;
+        std::uint64_t z = state;
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+        return (std::uint32_t)((z ^ (z >> 31)) >> 32);
+    };
+    auto unit = [&next]() { return (next() >> 8) * (1.0f / 16777216.0f); };
+
+    auto addPoint = [&](float x, float y)
+    {
+        // every copy of the point within the padding, shifted by the tile size like the cell it lands in
+        int firstX = std::min((int)(x * inverseCellSize), gridSize - 1) + reach;
+        int firstY = std::min((int)(y * inverseCellSize), gridSize - 1) + reach;
+        float shiftedX = x, shiftedY = y;
+        while (firstX >= gridSize)
+        {
+            firstX -= gridSize;
+            shiftedX -= tileSize;
+        }
+        while (firstY >= gridSize)
+        {
+            firstY -= gridSize;
+            shiftedY -= tileSize;
+        }
+        for (int copyY = firstY; copyY < paddedSize; copyY += gridSize, shiftedY += tileSize)
+        {
+            float copyX = shiftedX;
+            for (int cell = copyY * paddedSize + firstX; cell < (copyY + 1) * paddedSize; cell += gridSize, copyX += tileSize)
+            {
+                gridXs[cell] = copyX;
+                gridYs[cell] = shiftedY;
+            }
+        }
+        pointXs.push_back(x);
+        pointYs.push_back(y);
+    };
+
+    // A point at distance d blocks the candidates within the half angle acos((r'^2 + d^2 - r^2) / (2 r' d)) of its
+    // direction, law of cosines. The direction right past the end of that arc, a bit wider so rounding can't land
+    // the next candidate back inside, is the one to try after a candidate it blocked.
+    auto setArcEnd = [&](int i, float distance)
+    {
+        const float cosine = std::min((candidateSquared + distance * distance - radiusSquared) / (2.0f * candidateDistance * distance), 1.0f) - 1.0e-4f;
+        const float sine = std::sqrt(std::max(1.0f - cosine * cosine, 0.0f));
+        endXs[i] = (nearXs[i] * cosine - nearYs[i] * sine) / distance;
+        endYs[i] = (nearXs[i] * sine + nearYs[i] * cosine) / distance;
+    };
+
+    // Every point sweeps its circle once, in the order the points were added, so the tile fills from the first point
+    // outwards. Starting from a random direction, a candidate either becomes a point or is blocked by a neighbour,
+    // and either way the sweep goes on right past the arc that point blocks. The sweep ends once it passed the
+    // start, with every spot of the circle taken or ruled out, so every spot of the tile ends up within radius of a
+    // point; no candidate is ever tried where a known neighbour already rules it out.
+    addPoint(unit() * size, unit() * size);
+    for (unsigned int parent = 0; parent < pointXs.size(); parent++)
+    {
+        const float parentX = pointXs[parent], parentY = pointYs[parent];
+
+        // the neighbours that can block a candidate, relative to the parent, which itself is too close to count;
+        // every row is tested first and compacted after, so the test vectorizes
+        const int cellX = std::min((int)(parentX * inverseCellSize), gridSize - 1);
+        const int cellY = std::min((int)(parentY * inverseCellSize), gridSize - 1);
+        int nearCount = 0;
+        for (int row = cellY; row < cellY + rowCells; row++)
+        {
+            const float *rowXs = &gridXs[row * paddedSize + cellX], *rowYs = &gridYs[row * paddedSize + cellX];
+            for (int i = 0; i < rowCells; i++)
+            {
+                const float offsetX = rowXs[i] - parentX, offsetY = rowYs[i] - parentY;
+                const float distanceSquared = offsetX * offsetX + offsetY * offsetY;
+                rowNear[i] = distanceSquared < blockingSquared && distanceSquared > 0.25f * radiusSquared;
+            }
+            for (int i = 0; i < rowCells; i++)
+            {
+                nearXs[nearCount] = rowXs[i] - parentX;
+                nearYs[nearCount] = rowYs[i] - parentY;
+                nearCount += rowNear[i];
+            }
+        }
+        for (int i = 0; i < nearCount; i++)
+        {
+            setArcEnd(i, std::sqrt(nearXs[i] * nearXs[i] + nearYs[i] * nearYs[i]));
+        }
+
+        // random direction without trigonometry, from a point drawn in the unit disk
+        float startX, startY, lengthSquared;
+        do
+        {
+            startX = unit() * 2.0f - 1.0f;
+            startY = unit() * 2.0f - 1.0f;
+            lengthSquared = startX * startX + startY * startY;
+        } while (lengthSquared > 1.0f || lengthSquared < 0.01f);
+        const float inverseLength = 1.0f / std::sqrt(lengthSquared);
+        startX *= inverseLength;
+        startY *= inverseLength;
+
+        // every jump turns less than half a circle (arcs are at most 120 degrees wide), so the sweep passed the start
+        // once it went through the lower half and comes back into the upper one
+        float directionX = startX, directionY = startY;
+        bool lowerHalf = false;
+        while (true)
+        {
+            const float candidateX = directionX * candidateDistance, candidateY = directionY * candidateDistance;
+            int blocking = -1;
+            for (int i = 0; i < nearCount; i++)
+            {
+                const float dx = candidateX - nearXs[i], dy = candidateY - nearYs[i];
+                blocking = dx * dx + dy * dy < radiusSquared ? i : blocking;
+            }
+            if (blocking < 0)
+            {
+                addPoint(wrapCoordinate(parentX + candidateX, tileSize), wrapCoordinate(parentY + candidateY, tileSize));
+                for (int copyY = -copies; copyY <= copies; copyY++)
+                {
+                    for (int copyX = -copies; copyX <= copies; copyX++)
+                    {
+                        const float offsetX = candidateX + copyX * tileSize, offsetY = candidateY + copyY * tileSize;
+                        const float distanceSquared = offsetX * offsetX + offsetY * offsetY;
+                        if ((copyX == 0 && copyY == 0) || (distanceSquared < blockingSquared && distanceSquared > 0.25f * radiusSquared))
+                        {
+                            nearXs[nearCount] = offsetX;
+                            nearYs[nearCount] = offsetY;
+                            setArcEnd(nearCount, std::sqrt(distanceSquared));
+                            blocking = copyX == 0 && copyY == 0 ? nearCount : blocking;
+                            nearCount++;
+                        }
+                    }
+                }
+            }
+            directionX = endXs[blocking];
+            directionY = endYs[blocking];
+
+            const bool lower = startX * directionY - startY * directionX < 0.0f;
+            if (lowerHalf && !lower)
+            {
+                break;
+            }
+            lowerHalf |= lower;
+        }
+    }
+
+    xs.insert(xs.end(), pointXs.begin(), pointXs.end());
+    ys.insert(ys.end(), pointYs.begin(), pointYs.end());
+}
+
+unsigned int getPoissonMaxPoints(unsigned int size, float radius)
+{
+    // disks of half the radius around the points don't overlap, and hexagonal packing (2 / sqrt(3) points per squared
+    // radius) is the densest they get
+    return (unsigned int)(1.16f * size * size / (radius * radius)) + 4;
+}
+
+float getPoissonCoverage(float radius)
+{
+    // candidates sit just past the radius, so rounding never puts one within it
+    return radius * 1.0001f;
+}
+
+float getPoissonRadius(unsigned int size, unsigned int points)
+{
+    return std::sqrt(POISSON_DENSITY * size * size / std::max(1u, points));
+}
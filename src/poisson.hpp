@@ -0,0 +1,27 @@
+#pragma once
+
+#include <random>
+#include <vector>
+
+// working memory of the sampler, kept by the caller so repeated runs don't allocate
+struct PoissonScratch
+{
+    std::vector<float> gridXs, gridYs;
+    std::vector<float> pointXs, pointYs;
+    std::vector<float> nearXs, nearYs, endXs, endYs; // neighbours of the point being swept, where their arcs end
+    std::vector<int> rowNear;
+};
+
+// Bridson style Poisson disk sampling on a size x size torus: every point is at least radius away from every other
+// one, measured across the wrapped edges too, so the set tiles without clumps or seams. The sampling is maximal,
+// every spot of the tile is within radius of a point. Appends to xs and ys.
+void generatePoissonPoints(std::mt19937 &rand, unsigned int size, float radius, std::vector<float> &xs, std::vector<float> &ys, PoissonScratch &scratch);
+
+// no seed gives more points than this for a size x size tile sampled with radius
+unsigned int getPoissonMaxPoints(unsigned int size, float radius);
+
+// every spot of a tile sampled with radius is within this distance of a point
+float getPoissonCoverage(float radius);
+
+// radius that fills a size x size tile with about the given number of points
+float getPoissonRadius(unsigned int size, unsigned int points);
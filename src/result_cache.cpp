@@ -0,0 +1,198 @@
+#include "result_cache.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace fs = std::filesystem;
+
+ResultCache::ResultCache(const std::string &directory, std::uintmax_t maxBytes)
+    : _directory(directory), _maxBytes(maxBytes)
+{
+    std::error_code error;
+    fs::create_directories(_directory, error);
+    loadIndex();
+}
+
+bool ResultCache::fetch(std::uint64_t key, const std::string &filename)
+{
+    int entry = open(entryPath(key).c_str(), O_RDONLY);
+    struct stat entryStat;
+    if (entry < 0 || fstat(entry, &entryStat) != 0 || entryStat.st_size == 0)
+    {
+        if (entry >= 0)
+        {
+            close(entry);
+        }
+
+        std::lock_guard<std::mutex> lock(_mutex);
+        _stats.misses++;
+        return false;
+    }
+
+    // an evicted entry stays readable through the mapping until we let go of it
+    void *mapping = mmap(nullptr, entryStat.st_size, PROT_READ, MAP_PRIVATE, entry, 0);
+    bool copied = false;
+    int output = open(filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (mapping != MAP_FAILED && output >= 0)
+    {
+        const char *data = (const char *)mapping;
+        ssize_t remaining = entryStat.st_size;
+        while (remaining > 0)
+        {
+            ssize_t written = write(output, data, remaining);
+            if (written <= 0)
+            {
+                break;
+            }
+            data += written;
+            remaining -= written;
+        }
+        copied = remaining == 0;
+    }
+
+    // mark as recently used
+    futimens(entry, nullptr);
+
+    if (output >= 0)
+    {
+        close(output);
+    }
+    if (mapping != MAP_FAILED)
+    {
+        munmap(mapping, entryStat.st_size);
+    }
+    close(entry);
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    copied ? _stats.hits++ : _stats.misses++;
+    if (copied)
+    {
+        markUsed(key, entryStat.st_size);
+    }
+    return copied;
+}
+
+void ResultCache::store(std::uint64_t key, const std::vector<std::uint8_t> &data)
+{
+    // write aside and rename, so readers never see a partial entry
+    static std::atomic<unsigned int> tempCounter{0};
+    std::string path = entryPath(key);
+    std::string tempPath = path + "." + std::to_string(getpid()) + "_" + std::to_string(tempCounter++) + ".tmp";
+    {
+        std::ofstream file(tempPath, std::ios::binary);
+        file.write((const char *)data.data(), data.size());
+        if (!file)
+        {
+            std::remove(tempPath.c_str());
+            return;
+        }
+    }
+    std::error_code error;
+    fs::rename(tempPath, path, error);
+    if (error)
+    {
+        std::remove(tempPath.c_str());
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    markUsed(key, data.size());
+    if (_totalBytes > _maxBytes)
+    {
+        evict();
+    }
+}
+
+ResultCacheStats ResultCache::stats()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _stats;
+}
+
+std::string ResultCache::entryPath(std::uint64_t key) const
+{
+    char name[32];
+    std::snprintf(name, sizeof(name), "%016llx.bin", (unsigned long long)key);
+    return (fs::path(_directory) / name).string();
+}
+
+void ResultCache::loadIndex()
+{
+    struct Found
+    {
+        std::uint64_t key;
+        std::uintmax_t size;
+        fs::file_time_type lastUsed;
+    };
+
+    // the only scan of the directory, entries found later are the ones this cache stores
+    std::error_code error;
+    std::vector<Found> found;
+    for (const fs::directory_entry &file : fs::directory_iterator(_directory, error))
+    {
+        std::string name = file.path().filename().string();
+        char *end = nullptr;
+        std::uint64_t key = std::strtoull(name.c_str(), &end, 16);
+        if (file.path().extension() != ".bin" || name.size() != 20 || end != name.c_str() + 16)
+        {
+            continue;
+        }
+
+        std::uintmax_t size = file.file_size(error);
+        fs::file_time_type lastUsed = file.last_write_time(error);
+        if (!error)
+        {
+            found.push_back(Found{key, size, lastUsed});
+        }
+    }
+
+    // oldest first
+    std::sort(found.begin(), found.end(), [](const Found &a, const Found &b) { return a.lastUsed < b.lastUsed; });
+    for (const Found &entry : found)
+    {
+        markUsed(entry.key, entry.size);
+    }
+}
+
+void ResultCache::markUsed(std::uint64_t key, std::uintmax_t size)
+{
+    auto entry = _entries.find(key);
+    if (entry != _entries.end())
+    {
+        _totalBytes -= entry->second.size;
+        _useOrder.erase(entry->second.use);
+        _entries.erase(entry);
+    }
+
+    _useOrder.push_back(key);
+    _entries[key] = Entry{size, std::prev(_useOrder.end())};
+    _totalBytes += size;
+}
+
+void ResultCache::evict()
+{
+    // least recently used first, an entry removed behind our back only leaves the index
+    std::error_code error;
+    while (_totalBytes > _maxBytes && !_useOrder.empty())
+    {
+        std::uint64_t key = _useOrder.front();
+        if (fs::remove(entryPath(key), error))
+        {
+            _stats.evictions++;
+        }
+
+        _totalBytes -= _entries[key].size;
+        _entries.erase(key);
+        _useOrder.pop_front();
+    }
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+struct ResultCacheStats
+{
+    unsigned int hits = 0;
+    unsigned int misses = 0;
+    unsigned int evictions = 0;
+};
+
+// Finished outputs stored on disk under a hash of everything that went into producing them.
+// The least recently used entries get evicted once the directory grows past maxBytes. The sizes and the use order are
+// read from the directory once, on construction, and kept up to date in memory from then on.
+class ResultCache
+{
+public:
+    ResultCache(const std::string &directory, std::uintmax_t maxBytes);
+
+    // copies the entry for key to filename straight out of a memory mapping, false on a miss
+    bool fetch(std::uint64_t key, const std::string &filename);
+
+    // stores a finished result, then evicts (only when over the limit) until the cache fits it again
+    void store(std::uint64_t key, const std::vector<std::uint8_t> &data);
+
+    ResultCacheStats stats();
+
+private:
+    struct Entry
+    {
+        std::uintmax_t size;
+        std::list<std::uint64_t>::iterator use;
+    };
+
+    std::string entryPath(std::uint64_t key) const;
+    void loadIndex();
+    void markUsed(std::uint64_t key, std::uintmax_t size);
+    void evict();
+
+    std::string _directory;
+    std::uintmax_t _maxBytes;
+    std::mutex _mutex;
+    ResultCacheStats _stats;
+
+    // guarded by _mutex: keys from least to most recently used, and the size of each entry
+    std::list<std::uint64_t> _useOrder;
+    std::unordered_map<std::uint64_t, Entry> _entries;
+    std::uintmax_t _totalBytes = 0;
+};
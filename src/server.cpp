@@ -0,0 +1,294 @@
+#include "server.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <condition_variable>
+#include <cstring>
+#include <exception>
+#include <functional>
+#include <future>
+#include <iostream>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "batch.hpp"
+
+// longest request line, a client going past it without a newline gets an error and its connection closed
+const std::size_t MAX_REQUEST_BYTES = 4096;
+
+struct ServerState
+{
+    int listener;
+    ThreadPool &pool;
+    std::mutex mutex;
+    std::condition_variable closed;
+    std::vector<int> connections; // open ones, shut down on quit so their threads stop waiting for requests
+    bool quitting = false;
+};
+
+// memfd of size bytes written by fill through a shared mapping, then sealed so clients can rely on its contents
+static int createResultFile(std::size_t size, const std::function<void(std::uint8_t *)> &fill)
+{
+    int file = memfd_create("worley", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+    if (file < 0)
+    {
+        return -1;
+    }
+    if (ftruncate(file, size) != 0)
+    {
+        close(file);
+        return -1;
+    }
+
+    if (size > 0)
+    {
+        void *mapping = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, file, 0);
+        if (mapping == MAP_FAILED)
+        {
+            close(file);
+            return -1;
+        }
+        fill((std::uint8_t *)mapping);
+        munmap(mapping, size);
+    }
+
+    // unsealed, the promise to the client doesn't hold, so no result at all
+    if (fcntl(file, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_WRITE | F_SEAL_SEAL) != 0)
+    {
+        close(file);
+        return -1;
+    }
+    return file;
+}
+
+// sends one reply line, with file attached unless it is negative
+static bool sendReply(int connection, const std::string &line, int file)
+{
+    iovec data{(void *)line.data(), line.size()};
+    msghdr message{};
+    message.msg_iov = &data;
+    message.msg_iovlen = 1;
+
+    char control[CMSG_SPACE(sizeof(int))] = {};
+    if (file >= 0)
+    {
+        message.msg_control = control;
+        message.msg_controllen = sizeof(control);
+        cmsghdr *header = CMSG_FIRSTHDR(&message);
+        header->cmsg_level = SOL_SOCKET;
+        header->cmsg_type = SCM_RIGHTS;
+        header->cmsg_len = CMSG_LEN(sizeof(int));
+        std::memcpy(CMSG_DATA(header), &file, sizeof(int));
+    }
+
+    return sendmsg(connection, &message, MSG_NOSIGNAL) == (ssize_t)line.size();
+}
+
+static void replyToRequest(int connection, const std::string &line)
+{
+    // scratch lives as long as the worker thread
+    thread_local WorleyGenerator generator;
+    thread_local std::vector<std::uint8_t> pixels;
+    thread_local std::vector<float> floats;
+    thread_local std::vector<std::uint8_t> encoded;
+
+    WorleyJob job;
+    if (!parseWorleyJob(line, job))
+    {
+        sendReply(connection, "error invalid request\n", -1);
+        return;
+    }
+
+    std::size_t bytes = 0;
+    int file = -1;
+    if (job.output == "raw" && job.channels == WorleyJobChannels::Noise)
+    {
+        generator.update(job.params);
+        const unsigned int size = job.params.size;
+        bytes = size * size;
+        file = createResultFile(bytes, [](std::uint8_t *data) { generator.render(data, generator.params().size, 1); });
+    }
+    else
+    {
+        if (job.output == "raw")
+        {
+            generator.update(job.params);
+            generator.renderCells(encoded);
+        }
+        else if (!encodeWorleyJob(job, generator, pixels, floats, encoded))
+        {
+            sendReply(connection, "error unsupported format " + job.output + "\n", -1);
+            return;
+        }
+
+        bytes = encoded.size();
+        file = createResultFile(bytes, [](std::uint8_t *data) { std::copy(encoded.begin(), encoded.end(), data); });
+    }
+
+    if (file < 0)
+    {
+        sendReply(connection, "error could not create the result\n", -1);
+        return;
+    }
+    sendReply(connection, "ok " + std::to_string(bytes) + "\n", file);
+    close(file);
+}
+
+static void handleRequest(int connection, const std::string &line)
+{
+    // a failing request (out of memory, say) only costs its client the reply, the worker and the server go on
+    try
+    {
+        replyToRequest(connection, line);
+    }
+    catch (const std::exception &exception)
+    {
+        sendReply(connection, std::string("error ") + exception.what() + "\n", -1);
+    }
+}
+
+// reads the requests of one client, each one generated on the pool
+static void serveConnection(int connection, ServerState &state)
+{
+    std::string buffer;
+    char chunk[4096];
+    while (true)
+    {
+        std::size_t end = buffer.find('\n');
+        if ((end == std::string::npos ? buffer.size() : end) > MAX_REQUEST_BYTES)
+        {
+            sendReply(connection, "error request too long\n", -1);
+            break;
+        }
+        if (end == std::string::npos)
+        {
+            ssize_t received = recv(connection, chunk, sizeof(chunk), 0);
+            if (received <= 0)
+            {
+                break;
+            }
+            buffer.append(chunk, received);
+            continue;
+        }
+
+        std::string line = buffer.substr(0, end);
+        buffer.erase(0, end + 1);
+        if (!line.empty() && line.back() == '\r')
+        {
+            line.pop_back();
+        }
+
+        if (line == "quit")
+        {
+            // wakes up accept and every connection waiting for a request
+            std::lock_guard<std::mutex> lock(state.mutex);
+            state.quitting = true;
+            shutdown(state.listener, SHUT_RDWR);
+            for (int other : state.connections)
+            {
+                shutdown(other, SHUT_RD);
+            }
+            break;
+        }
+
+        // one request at a time per client, so replies keep the request order
+        std::promise<void> done;
+        state.pool.submit([connection, &line, &done]()
+        {
+            handleRequest(connection, line);
+            done.set_value();
+        });
+        done.get_future().wait();
+    }
+
+    std::lock_guard<std::mutex> lock(state.mutex);
+    state.connections.erase(std::find(state.connections.begin(), state.connections.end(), connection));
+    close(connection);
+    state.closed.notify_all();
+}
+
+bool runWorleyServer(const std::string &socketPath, ThreadPool &pool)
+{
+    sockaddr_un address{};
+    if (socketPath.size() >= sizeof(address.sun_path))
+    {
+        std::cout << "\tError: Socket path " << socketPath << " is too long" << std::endl;
+        return false;
+    }
+    address.sun_family = AF_UNIX;
+    std::memcpy(address.sun_path, socketPath.c_str(), socketPath.size() + 1);
+
+    // a socket left behind by a previous run would make bind fail, anything else at the path stays untouched
+    struct stat existing;
+    if (lstat(socketPath.c_str(), &existing) == 0)
+    {
+        if (!S_ISSOCK(existing.st_mode))
+        {
+            std::cout << "\tError: " << socketPath << " exists and is not a socket" << std::endl;
+            return false;
+        }
+        unlink(socketPath.c_str());
+    }
+    int listener = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (listener < 0 || bind(listener, (sockaddr *)&address, sizeof(address)) != 0 || listen(listener, SOMAXCONN) != 0)
+    {
+        std::cout << "\tError: Could not listen on " << socketPath << ": " << std::strerror(errno) << std::endl;
+        if (listener >= 0)
+        {
+            close(listener);
+        }
+        return false;
+    }
+
+    std::cout << "Serving on " << socketPath << " with " << pool.size() << " threads" << std::endl;
+    ServerState state{listener, pool};
+    while (true)
+    {
+        int connection = accept4(listener, nullptr, nullptr, SOCK_CLOEXEC);
+        int acceptError = errno;
+        std::lock_guard<std::mutex> lock(state.mutex);
+        if (state.quitting)
+        {
+            if (connection >= 0)
+            {
+                close(connection);
+            }
+            break;
+        }
+        if (connection < 0)
+        {
+            if (acceptError == EINTR || acceptError == ECONNABORTED)
+            {
+                continue;
+            }
+            std::cout << "\tError: Could not accept a connection: " << std::strerror(acceptError) << std::endl;
+            break;
+        }
+
+        // a thread per client only waits for requests, the pool does the work
+        state.connections.push_back(connection);
+        std::thread(serveConnection, connection, std::ref(state)).detach();
+    }
+
+    // the rest of the clients get to finish the request they are on
+    {
+        std::unique_lock<std::mutex> lock(state.mutex);
+        for (int connection : state.connections)
+        {
+            shutdown(connection, SHUT_RD);
+        }
+        state.closed.wait(lock, [&state]() { return state.connections.empty(); });
+    }
+    close(listener);
+    unlink(socketPath.c_str());
+    return true;
+}
@@ -0,0 +1,14 @@
+#pragma once
+
+#include <string>
+
+#include "thread_pool.hpp"
+
+// Serves generation requests on a unix domain socket until a client sends quit.
+// A request is one line in the job file syntax (see loadWorleyJobs) with the output replaced by a format: raw for the
+// plain pixels (1 byte per pixel, 3 for cells), or png, bmp, tga, hdr or f32. The reply is a line "ok <bytes>" with a
+// sealed memfd holding the result attached, or "error <reason>". Raw pixels are toned straight into the memfd.
+// Every connection gets a thread of its own that only reads its requests, the requests themselves run on the pool,
+// whose workers keep their generator and buffers between requests.
+// Returns false when the socket can't be set up, or when something other than a socket is in the way at socketPath.
+bool runWorleyServer(const std::string &socketPath, ThreadPool &pool);
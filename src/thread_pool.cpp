@@ -0,0 +1,71 @@
+#include "thread_pool.hpp"
+
+#include <algorithm>
+
+ThreadPool::ThreadPool(unsigned int numThreads)
+{
+    for (unsigned int i = 0; i < std::max(1u, numThreads); i++)
+    {
+        _threads.emplace_back(&ThreadPool::work, this);
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _stopping = true;
+    }
+    _taskQueued.notify_all();
+
+    for (std::thread &thread : _threads)
+    {
+        if (thread.joinable())
+        {
+            thread.join();
+        }
+    }
+}
+
+void ThreadPool::submit(std::function<void()> task)
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _tasks.push(std::move(task));
+        _busyTasks++;
+    }
+    _taskQueued.notify_one();
+}
+
+void ThreadPool::wait()
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+    _tasksDone.wait(lock, [this]() { return _busyTasks == 0; });
+}
+
+void ThreadPool::work()
+{
+    while (true)
+    {
+        std::function<void()> task;
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _taskQueued.wait(lock, [this]() { return _stopping || !_tasks.empty(); });
+            if (_tasks.empty())
+            {
+                return;
+            }
+
+            task = std::move(_tasks.front());
+            _tasks.pop();
+        }
+
+        task();
+
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _busyTasks--;
+        }
+        _tasksDone.notify_all();
+    }
+}
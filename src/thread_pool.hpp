@@ -0,0 +1,38 @@
+#pragma once
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+// fixed set of worker threads consuming a shared task queue
+class ThreadPool
+{
+public:
+    explicit ThreadPool(unsigned int numThreads);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+
+    // queues a task, it runs on the first idle worker
+    void submit(std::function<void()> task);
+
+    // blocks until every queued task has finished
+    void wait();
+
+    unsigned int size() const { return _threads.size(); }
+
+private:
+    void work();
+
+    std::vector<std::thread> _threads;
+    std::queue<std::function<void()>> _tasks;
+    std::mutex _mutex;
+    std::condition_variable _taskQueued;
+    std::condition_variable _tasksDone;
+    unsigned int _busyTasks = 0;
+    bool _stopping = false;
+};
@@ -0,0 +1,99 @@
+#include "volume.hpp"
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <vector>
+
+// Runs the slices of the brick starting at firstSlice on workers pool tasks, then waits. Worker k gets slices k,
+// k + workers... and calls generateSlice(k, slice, seed), so it can keep its own scratch between slices.
+template <typename GenerateSlice>
+static void runBrick(ThreadPool &pool, unsigned int workers, std::mt19937 &sliceSeeds, std::vector<unsigned int> &seeds, unsigned int firstSlice, unsigned int brickSlices, const GenerateSlice &generateSlice)
+{
+    // drawn in slice order, like the seeds of the spritesheet slices
+    seeds.resize(brickSlices);
+    for (unsigned int &seed : seeds)
+    {
+        seed = sliceSeeds();
+    }
+    for (unsigned int worker = 0; worker < workers; worker++)
+    {
+        pool.submit([&generateSlice, &seeds, worker, workers, firstSlice, brickSlices]()
+        {
+            for (unsigned int slice = worker; slice < brickSlices; slice += workers)
+            {
+                generateSlice(worker, firstSlice + slice, seeds[slice]);
+            }
+        });
+    }
+    pool.wait();
+}
+
+bool writeWorleyVolume(const std::string &filename, WorleyParams params, unsigned int volumeSeed, unsigned int brickSlices, bool normalize, float normalizePercentile, ThreadPool &pool)
+{
+    const unsigned int size = params.size;
+    const std::size_t slicePixels = (std::size_t)size * size;
+    brickSlices = std::max(1u, std::min(brickSlices, size));
+
+    // A generator per worker, both passes share them, and never more workers than the brick has slices. They only
+    // place the points and sample every pixel from those, without the per pixel fields of a full update, so what a
+    // worker keeps is its points and their grid and memory goes with the brick.
+    const unsigned int workers = std::max(1u, std::min<unsigned int>(pool.size(), brickSlices));
+    std::vector<WorleyGenerator> generators(workers);
+    std::vector<unsigned int> seeds;
+
+    // the whole volume once without keeping anything, only to count the distances
+    if (normalize)
+    {
+        std::vector<unsigned int> histogram(WORLEY_HISTOGRAM_BINS);
+        std::vector<std::vector<unsigned int>> bins(workers, std::vector<unsigned int>(WORLEY_HISTOGRAM_BINS));
+        std::mt19937 sliceSeeds(volumeSeed);
+        for (unsigned int brick = 0; brick < size; brick += brickSlices)
+        {
+            runBrick(pool, workers, sliceSeeds, seeds, brick, std::min(brickSlices, size - brick), [&](unsigned int worker, unsigned int, unsigned int seed)
+            {
+                WorleyParams sliceParams = params;
+                sliceParams.seed = seed;
+                generators[worker].updatePoints(sliceParams);
+                generators[worker].accumulateHistogramFromPoints(bins[worker]);
+            });
+        }
+
+        for (const std::vector<unsigned int> &workerBins : bins)
+        {
+            for (unsigned int i = 0; i < WORLEY_HISTOGRAM_BINS; i++)
+            {
+                histogram[i] += workerBins[i];
+            }
+        }
+        findWorleyToneRange(histogram, size, normalizePercentile, params.rangeMin, params.rangeMax);
+        std::cout << "Normalized distances to [" << params.rangeMin << ", " << params.rangeMax << "]" << std::endl;
+    }
+
+    std::ofstream file(filename, std::ios::binary);
+    if (!file)
+    {
+        return false;
+    }
+
+    // every worker renders its slices straight into their place in the brick
+    std::vector<std::uint8_t> brickPixels(brickSlices * slicePixels);
+    std::mt19937 sliceSeeds(volumeSeed);
+    for (unsigned int brick = 0; brick < size && file; brick += brickSlices)
+    {
+        const unsigned int slices = std::min(brickSlices, size - brick);
+        runBrick(pool, workers, sliceSeeds, seeds, brick, slices, [&](unsigned int worker, unsigned int slice, unsigned int seed)
+        {
+            WorleyParams sliceParams = params;
+            sliceParams.seed = seed;
+            generators[worker].updatePoints(sliceParams);
+            generators[worker].renderFromPoints(&brickPixels[(slice - brick) * slicePixels], size);
+        });
+
+        file.write((const char *)brickPixels.data(), slices * slicePixels);
+    }
+
+    file.close();
+    return (bool)file;
+}
@@ -0,0 +1,14 @@
+#pragma once
+
+#include <string>
+
+#include "thread_pool.hpp"
+#include "worley.hpp"
+
+// Writes a volume of params.size slices of params.size * params.size noise bytes, slice after slice, into filename.
+// The slices get generated brickSlices at a time on at most brickSlices pool threads, and every brick is written before
+// the next one starts. The threads sample the slices from their points alone (see renderFromPoints), so memory holds
+// one brick and the points of a slice per thread, whatever the size of the volume.
+// The slice seeds follow from volumeSeed like the seeds of the spritesheet slices. With normalize a first pass over
+// every brick finds the tone range (see findWorleyToneRange) without keeping any slice.
+bool writeWorleyVolume(const std::string &filename, WorleyParams params, unsigned int volumeSeed, unsigned int brickSlices, bool normalize, float normalizePercentile, ThreadPool &pool);
@@ -0,0 +1,74 @@
+#include "worker_processes.hpp"
+
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+SharedMemory::SharedMemory(std::size_t size)
+    : _data(nullptr), _size(size)
+{
+    void *mapping = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (mapping == MAP_FAILED)
+    {
+        std::cout << "\tError: Could not map " << size << " bytes of shared memory: " << std::strerror(errno) << std::endl;
+        return;
+    }
+    _data = mapping;
+}
+
+SharedMemory::~SharedMemory()
+{
+    if (_data)
+    {
+        munmap(_data, _size);
+    }
+}
+
+unsigned int runWorkerProcesses(unsigned int count, const std::function<bool(unsigned int)> &work)
+{
+    // whatever is still buffered would get written once by every worker too
+    std::cout.flush();
+
+    std::vector<pid_t> workers;
+    for (unsigned int i = 0; i < count; i++)
+    {
+        pid_t pid = fork();
+        if (pid == 0)
+        {
+            bool succeeded = work(i);
+            std::cout.flush();
+            // no destructors or atexit handlers, those belong to the parent
+            _exit(succeeded ? 0 : 1);
+        }
+        if (pid < 0)
+        {
+            std::cout << "\tError: Could not start worker process: " << std::strerror(errno) << std::endl;
+            break;
+        }
+        workers.push_back(pid);
+    }
+
+    unsigned int failed = count - workers.size();
+    for (pid_t pid : workers)
+    {
+        int status;
+        while (waitpid(pid, &status, 0) < 0)
+        {
+            if (errno != EINTR)
+            {
+                status = -1;
+                break;
+            }
+        }
+        if (status == -1 || !WIFEXITED(status) || WEXITSTATUS(status) != 0)
+        {
+            failed++;
+        }
+    }
+    return failed;
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+
+// Memory shared with forked worker processes: an anonymous shared mapping made before the fork, so the workers write
+// straight into pages the parent reads afterwards. Starts zeroed.
+class SharedMemory
+{
+public:
+    explicit SharedMemory(std::size_t size);
+    ~SharedMemory();
+
+    SharedMemory(const SharedMemory &) = delete;
+    SharedMemory &operator=(const SharedMemory &) = delete;
+
+    // null when the mapping failed
+    void *data() const { return _data; }
+    std::size_t size() const { return _size; }
+
+private:
+    void *_data;
+    std::size_t _size;
+};
+
+// Forks count worker processes, each running work(index) and exiting, with a failure when it returns false or dies.
+// Waits for all of them and returns how many failed, count when not even the fork worked.
+// A forked process only keeps the thread that forked, so call it before anything started threads that the workers
+// would need (thread pools, file writers).
+unsigned int runWorkerProcesses(unsigned int count, const std::function<bool(unsigned int)> &work);
@@ -0,0 +1,1420 @@
+#include "worley.hpp"
+
+#include "poisson.hpp"
+
+#include <cstring>
+#include <limits>
+
+const float NO_DISTANCE = std::numeric_limits<float>::infinity();
+const int PRETTY_REMAP_MAX = 2048;
+const unsigned int MAX_TONE_LUT_SIZE = 1 << 20;
+
+static int remap(int value, int min, int max, int newMin, int newMax)
+{
+    return newMin + (value - min) * (newMax - newMin) / (max - min);
+}
+
+static void getToneRange(const WorleyParams &params, float &rangeMin, float &rangeMax)
+{
+    rangeMin = params.rangeMin;
+    rangeMax = params.rangeMax;
+    if (rangeMax <= rangeMin)
+    {
+        rangeMin = 0.0f;
+        rangeMax = params.size * 0.5f;
+    }
+}
+
+static std::uint8_t toneDistance(float distance, const WorleyParams &params)
+{
+    if (params.curve == WorleyRemapCurve::Pretty)
+    {
+        int color = std::min(distance, 255.0f);
+        return 255 - std::min(remap(color, 0, 255, 0, PRETTY_REMAP_MAX), 255); // remap for pretty
+    }
+
+    float rangeMin, rangeMax;
+    getToneRange(params, rangeMin, rangeMax);
+    float normalized = std::min(std::max((distance - rangeMin) / (rangeMax - rangeMin), 0.0f), 1.0f);
+    switch (params.curve)
+    {
+    case WorleyRemapCurve::Gamma:
+        normalized = std::pow(normalized, params.gamma);
+        break;
+    case WorleyRemapCurve::Smoothstep:
+        normalized = normalized * normalized * (3.0f - 2.0f * normalized);
+        break;
+    case WorleyRemapCurve::Custom:
+        if (params.customCurve.size() == 256)
+        {
+            return params.customCurve[std::lround(normalized * 255.0f)];
+        }
+        break;
+    default:
+        break;
+    }
+
+    return 255 - std::lround(normalized * 255.0f);
+}
+
+// smallest distance from which the curve stays flat
+static float getSaturationDistance(const WorleyParams &params)
+{
+    if (params.curve == WorleyRemapCurve::Pretty)
+    {
+        return std::ceil(255.0f * 255.0f / PRETTY_REMAP_MAX);
+    }
+
+    float rangeMin, rangeMax;
+    getToneRange(params, rangeMin, rangeMax);
+    return rangeMax;
+}
+
+// The metrics return keys that sort like the distances but are cheaper: squared for euclidean, no root for
+// minkowski. On integer point and pixel coordinates the euclidean, manhattan and chebyshev keys are integers,
+// exact in float arithmetic as long as they stay below 2^24.
+static float keyToDistance(float key, const WorleyParams &params)
+{
+    switch (params.metric)
+    {
+    case WorleyMetric::Euclidean:
+        return std::sqrt(key);
+    case WorleyMetric::Minkowski:
+        return std::pow(key, 1.0f / params.minkowskiExponent);
+    default:
+        return key;
+    }
+}
+
+static float distanceToKey(float distance, const WorleyParams &params)
+{
+    switch (params.metric)
+    {
+    case WorleyMetric::Euclidean:
+        return distance * distance;
+    case WorleyMetric::Minkowski:
+        return std::pow(distance, params.minkowskiExponent);
+    default:
+        return distance;
+    }
+}
+
+// dx and dy are already the shortest way around the wrapped tile
+struct EuclideanMetric
+{
+    float operator()(float dx, float dy) const { return dx * dx + dy * dy; }
+};
+
+struct ManhattanMetric
+{
+    float operator()(float dx, float dy) const { return dx + dy; }
+};
+
+struct ChebyshevMetric
+{
+    float operator()(float dx, float dy) const { return std::max(dx, dy); }
+};
+
+struct MinkowskiMetric
+{
+    float exponent;
+    float operator()(float dx, float dy) const { return std::pow(dx, exponent) + std::pow(dy, exponent); }
+};
+
+// wrapped distance from a point to the closest and the furthest pixel of [first, last] on one axis
+static void getAxisBounds(float point, float first, float last, float size, float &closest, float &furthest)
+{
+    float toFirst = std::abs(first - point), toLast = std::abs(last - point);
+    toFirst = std::min(toFirst, size - toFirst);
+    toLast = std::min(toLast, size - toLast);
+    closest = (point >= first && point <= last) ? 0.0f : std::min(toFirst, toLast);
+
+    // the distance only falls again past the opposite side of the tile
+    float opposite = point + size * 0.5f;
+    if (opposite >= size)
+    {
+        opposite -= size;
+    }
+    furthest = (opposite >= first && opposite <= last) ? size * 0.5f : std::max(toFirst, toLast);
+}
+
+// offset between two coordinates the shortest way around the tile
+static float wrapOffset(float offset, float size)
+{
+    // two plain selects, so loops over it still vectorize
+    const float halfSize = size * 0.5f;
+    offset -= offset > halfSize ? size : 0.0f;
+    return offset + (offset < -halfSize ? size : 0.0f);
+}
+
+bool WorleyGenerator::update(const WorleyParams &params, const std::function<void(unsigned int)> &onPass, const std::function<bool()> &isCancelled)
+{
+    switch (params.metric)
+    {
+    case WorleyMetric::Manhattan:
+        return updateWith(ManhattanMetric(), params, onPass, isCancelled);
+    case WorleyMetric::Chebyshev:
+        return updateWith(ChebyshevMetric(), params, onPass, isCancelled);
+    case WorleyMetric::Minkowski:
+        return updateWith(MinkowskiMetric{params.minkowskiExponent}, params, onPass, isCancelled);
+    default:
+        return updateWith(EuclideanMetric(), params, onPass, isCancelled);
+    }
+}
+
+template <typename Metric>
+bool WorleyGenerator::updateWith(const Metric &metric, const WorleyParams &params, const std::function<void(unsigned int)> &onPass, const std::function<bool()> &isCancelled)
+{
+    // a new seed, size, metric or point distribution invalidates everything, so do poisson and time loop point count
+    // changes as those don't keep the previous points, and new frames as those move every point
+    bool pointsChanged = (params.distribution == WorleyPointDistribution::Poisson || params.frames > 1) && params.points != _params.points;
+    bool pointsMoved = params.frames != _params.frames || (params.frames > 1 && params.frame != _params.frame);
+    if (!_valid || params.seed != _params.seed || params.size != _params.size || params.metric != _params.metric ||
+        params.minkowskiExponent != _params.minkowskiExponent || params.distribution != _params.distribution || pointsChanged ||
+        pointsMoved)
+    {
+        // the next frame of the same loop keeps the starts of the points, even poisson ones don't get drawn again
+        bool keepPoints = _valid && params.seed == _params.seed && params.size == _params.size &&
+                          params.distribution == _params.distribution && !pointsChanged && params.frames == _params.frames &&
+                          params.frames > 1;
+        _valid = false;
+        _params = params;
+        buildToneLut();
+        const unsigned int keptOctaves = keepPoints ? std::min<unsigned int>(_octaves.size(), params.octaves) : 0;
+        _octaves.resize(params.octaves); // kept octaves reuse their buffers
+        for (unsigned int i = 0; i < _octaves.size(); i++)
+        {
+            resetOctave(_octaves[i], i, i < keptOctaves);
+        }
+
+        for (unsigned int step = COARSEST_STEP; step > 0; step /= 2)
+        {
+            for (OctaveField &octave : _octaves)
+            {
+                if (!sampleOctave(metric, octave, step, step != COARSEST_STEP, isCancelled))
+                {
+                    return false;
+                }
+                if (params.mode == WorleyDistanceMode::Edge && !sampleEdges(octave, step, step != COARSEST_STEP, isCancelled))
+                {
+                    return false;
+                }
+            }
+
+            if (onPass)
+            {
+                onPass(step);
+            }
+        }
+
+        buildPointGrids();
+        _valid = true;
+        return true;
+    }
+
+    // the rest can be patched in place, a cancelled patch leaves the field for a rebuild
+    bool edgesStale = _params.mode != WorleyDistanceMode::Edge;
+    _valid = false;
+    _params = params;
+    buildToneLut();
+    if (_octaves.size() > params.octaves)
+    {
+        _octaves.resize(params.octaves);
+    }
+
+    // changed point counts only touch the pixels that gained or lost a closest point
+    for (unsigned int i = 0; i < _octaves.size(); i++)
+    {
+        OctaveField &octave = _octaves[i];
+        unsigned int previousCount = octave.count;
+        // poisson points only ever change with a rebuild, their count isn't the requested one
+        if (params.distribution == WorleyPointDistribution::Uniform)
+        {
+            resizeOctavePoints(octave, params.points << (2 * i));
+        }
+        if (octave.count == previousCount)
+        {
+            continue;
+        }
+        edgesStale = true;
+
+        // added points are compared against the kept closest ones, removed ones force a full rescan
+        gatherCandidates(octave, octave.count > previousCount ? previousCount : 0);
+        for (unsigned int y = 0; y < params.size; y++)
+        {
+            if (isCancelled && isCancelled())
+            {
+                return false;
+            }
+
+            for (unsigned int x = 0; x < params.size; x++)
+            {
+                unsigned int index = y * params.size + x;
+                if (octave.count > previousCount)
+                {
+                    samplePixel(metric, octave, x, y, true);
+                }
+                else if (octave.nearest1[index] >= octave.count || octave.nearest2[index] >= octave.count)
+                {
+                    samplePixel(metric, octave, x, y, false);
+                }
+            }
+        }
+    }
+
+    // added octaves get sampled in full
+    while (_octaves.size() < params.octaves)
+    {
+        _octaves.emplace_back();
+        resetOctave(_octaves.back(), _octaves.size() - 1);
+        if (!sampleOctave(metric, _octaves.back(), 1, false, isCancelled))
+        {
+            return false;
+        }
+        edgesStale = true;
+    }
+
+    // edges depend on every closest point around, so they are redone in full
+    if (params.mode == WorleyDistanceMode::Edge && edgesStale)
+    {
+        for (OctaveField &octave : _octaves)
+        {
+            if (!sampleEdges(octave, 1, false, isCancelled))
+            {
+                return false;
+            }
+        }
+    }
+
+    buildPointGrids();
+    _valid = true;
+    if (onPass)
+    {
+        onPass(1);
+    }
+    return true;
+}
+
+void WorleyGenerator::updatePoints(const WorleyParams &params)
+{
+    // the fields no longer match the points, the next update rebuilds them
+    _valid = false;
+    _params = params;
+    buildToneLut();
+    _octaves.resize(params.octaves);
+    for (unsigned int i = 0; i < _octaves.size(); i++)
+    {
+        resetOctavePoints(_octaves[i], i);
+    }
+    buildPointGrids();
+}
+
+void WorleyGenerator::render(std::vector<std::uint8_t> &pixels, unsigned int channels, unsigned int step) const
+{
+    pixels.resize(_params.size * _params.size * channels);
+    render(pixels.data(), _params.size * channels, channels, step);
+}
+
+void WorleyGenerator::render(std::uint8_t *pixels, std::size_t stride, unsigned int channels, unsigned int step) const
+{
+    const unsigned int size = _params.size;
+    for (unsigned int y = 0; y < size; y++)
+    {
+        std::uint8_t *row = pixels + y * stride;
+        for (unsigned int x = 0; x < size; x++)
+        {
+            // coarse passes only have the top left sample of every step x step block
+            std::uint8_t color = tonePixel((y - y % step) * size + x - x % step);
+            unsigned int index = x * channels;
+            if (channels == 4)
+            {
+                row[index + 0] = color;
+                row[index + 1] = color;
+                row[index + 2] = color;
+                row[index + 3] = 255;
+            }
+            else
+            {
+                row[index] = color;
+            }
+        }
+    }
+}
+
+void WorleyGenerator::renderDistances(std::vector<float> &distances) const
+{
+    distances.resize(_params.size * _params.size * 3);
+    renderDistances(distances.data(), _params.size * 3 * sizeof(float));
+}
+
+void WorleyGenerator::renderDistances(float *distances, std::size_t stride) const
+{
+    // planar accumulation so the key to distance conversion runs over plain float arrays
+    const unsigned int pixels = _params.size * _params.size;
+    const float inverseSize = 1.0f / _params.size;
+    std::vector<float> &f1 = _renderF1, &f2 = _renderF2;
+    f1.assign(pixels, 0.0f);
+    f2.assign(pixels, 0.0f);
+    float weights = 0.0f, weight = 1.0f;
+    for (const OctaveField &octave : _octaves)
+    {
+        const float *keys1 = octave.f1.data(), *keys2 = octave.f2.data();
+        const float scale = weight * inverseSize;
+        switch (_params.metric)
+        {
+        case WorleyMetric::Euclidean:
+            for (unsigned int i = 0; i < pixels; i++)
+            {
+                f1[i] += scale * std::min(std::sqrt(keys1[i]), (float)_params.size);
+                f2[i] += scale * std::min(std::sqrt(keys2[i]), (float)_params.size);
+            }
+            break;
+        case WorleyMetric::Minkowski:
+            for (unsigned int i = 0; i < pixels; i++)
+            {
+                f1[i] += scale * std::min(keyToDistance(keys1[i], _params), (float)_params.size);
+                f2[i] += scale * std::min(keyToDistance(keys2[i], _params), (float)_params.size);
+            }
+            break;
+        default:
+            for (unsigned int i = 0; i < pixels; i++)
+            {
+                f1[i] += scale * std::min(keys1[i], (float)_params.size);
+                f2[i] += scale * std::min(keys2[i], (float)_params.size);
+            }
+            break;
+        }
+        weights += weight;
+        weight *= 0.5f;
+    }
+
+    const float inverseWeights = 1.0f / weights;
+    for (unsigned int y = 0; y < _params.size; y++)
+    {
+        float *row = (float *)((std::uint8_t *)distances + y * stride);
+        for (unsigned int x = 0; x < _params.size; x++)
+        {
+            unsigned int i = y * _params.size + x;
+            row[x * 3 + 0] = f1[i] * inverseWeights;
+            row[x * 3 + 1] = f2[i] * inverseWeights;
+            row[x * 3 + 2] = (f2[i] - f1[i]) * inverseWeights;
+        }
+    }
+}
+
+// well mixed bits per point, so neighboring cells rarely get similar colors
+static std::uint32_t hashCell(std::uint32_t seed, std::uint32_t index)
+{
+    std::uint32_t hash = seed ^ (index * 0x9E3779B9u);
+    hash ^= hash >> 16;
+    hash *= 0x85EBCA6Bu;
+    hash ^= hash >> 13;
+    hash *= 0xC2B2AE35u;
+    hash ^= hash >> 16;
+    return hash;
+}
+
+void WorleyGenerator::renderCells(std::vector<std::uint8_t> &pixels) const
+{
+    pixels.resize(_params.size * _params.size * 3);
+    renderCells(pixels.data(), _params.size * 3);
+}
+
+void WorleyGenerator::renderCells(std::uint8_t *pixels, std::size_t stride) const
+{
+    const OctaveField &octave = _octaves[0];
+    const unsigned int size = _params.size;
+    for (unsigned int y = 0; y < size; y++)
+    {
+        std::uint8_t *row = pixels + y * stride;
+        for (unsigned int x = 0; x < size; x++)
+        {
+            std::uint32_t color = hashCell(_params.seed, octave.nearest1[y * size + x]);
+            row[x * 3 + 0] = color;
+            row[x * 3 + 1] = color >> 8;
+            row[x * 3 + 2] = color >> 16;
+        }
+    }
+}
+
+void WorleyGenerator::renderOffsets(std::vector<float> &offsets) const
+{
+    offsets.resize(_params.size * _params.size * 3);
+    renderOffsets(offsets.data(), _params.size * 3 * sizeof(float));
+}
+
+void WorleyGenerator::renderOffsets(float *offsets, std::size_t stride) const
+{
+    const OctaveField &octave = _octaves[0];
+    const unsigned int size = _params.size;
+    const float inverseSize = 1.0f / size;
+    for (unsigned int y = 0; y < size; y++)
+    {
+        float *row = (float *)((std::uint8_t *)offsets + y * stride);
+        for (unsigned int x = 0; x < size; x++)
+        {
+            unsigned int nearest = octave.nearest1[y * size + x];
+            row[x * 3 + 0] = wrapOffset(octave.xs[nearest] - x, size) * inverseSize;
+            row[x * 3 + 1] = wrapOffset(octave.ys[nearest] - y, size) * inverseSize;
+            row[x * 3 + 2] = nearest;
+        }
+    }
+}
+
+void WorleyGenerator::resetOctave(OctaveField &octave, unsigned int index, bool keepPoints)
+{
+    if (keepPoints)
+    {
+        moveOctavePoints(octave, index);
+    }
+    else
+    {
+        resetOctavePoints(octave, index);
+    }
+
+    const unsigned int pixels = _params.size * _params.size;
+    octave.f1.assign(pixels, NO_DISTANCE);
+    octave.f2.assign(pixels, NO_DISTANCE);
+    octave.nearest1.assign(pixels, 0);
+    octave.nearest2.assign(pixels, 0);
+    octave.edges.assign(pixels, 0.0f);
+}
+
+void WorleyGenerator::resetOctavePoints(OctaveField &octave, unsigned int index)
+{
+    // every octave has its own point sequence, 4 times denser than the previous one
+    octave.rand.seed(_params.seed + index * 0x9E3779B9u);
+    octave.xs.clear();
+    octave.ys.clear();
+    octave.count = 0;
+    octave.pointReach = 0.0f;
+    if (_params.distribution == WorleyPointDistribution::Poisson)
+    {
+        // snapped to pixels like the uniform points, so the distance keys stay integers
+        float radius = getPoissonRadius(_params.size, _params.points << (2 * index));
+        // the count changes with the seed, room for the most any seed gives keeps later seeds from allocating
+        const unsigned int maxPoints = getPoissonMaxPoints(_params.size, radius);
+        const unsigned int maxGridSize = std::max(1u, std::min(_params.size, (unsigned int)std::sqrt(maxPoints * 0.5f)));
+        reserveCandidates(maxPoints);
+        octave.cellStarts.reserve(maxGridSize * maxGridSize + 1);
+        octave.cellPoints.reserve(maxPoints);
+        generatePoissonPoints(octave.rand, _params.size, radius, octave.xs, octave.ys, _poissonScratch);
+        for (unsigned int i = 0; i < octave.xs.size(); i++)
+        {
+            octave.xs[i] = std::floor(octave.xs[i]);
+            octave.ys[i] = std::floor(octave.ys[i]);
+        }
+        octave.count = octave.xs.size();
+
+        // the sampling covers the tile, which bounds the culling by the grid; snapping moves a point by up to a
+        // pixel diagonal, looping points move far more
+        if (_params.frames <= 1)
+        {
+            octave.pointReach = getPoissonCoverage(radius) + std::sqrt(2.0f);
+            buildPointGrid(octave);
+        }
+    }
+    else
+    {
+        resizeOctavePoints(octave, _params.points << (2 * index));
+    }
+
+    if (_params.frames > 1)
+    {
+        octave.startXs.assign(octave.xs.begin(), octave.xs.begin() + octave.count);
+        octave.startYs.assign(octave.ys.begin(), octave.ys.begin() + octave.count);
+        moveOctavePoints(octave, index);
+    }
+}
+
+void WorleyGenerator::moveOctavePoints(OctaveField &octave, unsigned int index)
+{
+    // Every point goes once or twice around its start per axis, so it is back there after the last frame, in a loop
+    // up to half the average point spacing wide. Snapped to pixels like the points themselves, so the distance keys
+    // stay integers.
+    const float TWO_PI = 6.28318531f;
+    const float time = (float)(_params.frame % _params.frames) / _params.frames;
+    const float spacing = _params.size / std::sqrt((float)std::max(octave.count, 1u));
+    const long size = _params.size;
+    const std::uint32_t seed = _params.seed + index * 0x9E3779B9u;
+    for (unsigned int i = 0; i < octave.count; i++)
+    {
+        std::uint32_t hash = hashCell(seed, i);
+        float radius = 0.5f * spacing * ((hash & 0xFF) + 1) / 256.0f;
+        float phase = (hash >> 8 & 0xFFF) / 4096.0f;
+        float turnsX = 1.0f + (hash >> 20 & 1), turnsY = (1.0f + (hash >> 21 & 1)) * (hash >> 22 & 1 ? -1.0f : 1.0f);
+        long x = std::lround(octave.startXs[i] + radius * std::cos(TWO_PI * (turnsX * time + phase)));
+        long y = std::lround(octave.startYs[i] + radius * std::sin(TWO_PI * (turnsY * time + phase)));
+        octave.xs[i] = (x % size + size) % size;
+        octave.ys[i] = (y % size + size) % size;
+    }
+}
+
+void WorleyGenerator::buildPointGrids()
+{
+    for (OctaveField &octave : _octaves)
+    {
+        buildPointGrid(octave);
+    }
+}
+
+void WorleyGenerator::buildPointGrid(OctaveField &octave)
+{
+    // about two points per cell, counting sorted so every cell lists its points in point order
+    const unsigned int size = _params.size;
+    const unsigned int gridSize = std::max(1u, std::min(size, (unsigned int)std::sqrt(octave.count * 0.5f)));
+    octave.gridSize = gridSize;
+    octave.cellStarts.assign(gridSize * gridSize + 1, 0);
+    octave.cellPoints.resize(octave.count);
+    auto getCell = [&octave, gridSize, size](unsigned int i)
+    {
+        return ((unsigned int)octave.ys[i] * gridSize / size) * gridSize + (unsigned int)octave.xs[i] * gridSize / size;
+    };
+
+    for (unsigned int i = 0; i < octave.count; i++)
+    {
+        octave.cellStarts[getCell(i) + 1]++;
+    }
+    for (unsigned int cell = 0; cell < gridSize * gridSize; cell++)
+    {
+        octave.cellStarts[cell + 1] += octave.cellStarts[cell];
+    }
+    // the starts serve as write positions, which leaves each at the start of the next cell
+    for (unsigned int i = 0; i < octave.count; i++)
+    {
+        octave.cellPoints[octave.cellStarts[getCell(i)]++] = i;
+    }
+    for (unsigned int cell = gridSize * gridSize; cell > 0; cell--)
+    {
+        octave.cellStarts[cell] = octave.cellStarts[cell - 1];
+    }
+    octave.cellStarts[0] = 0;
+}
+
+void WorleyGenerator::resizeOctavePoints(OctaveField &octave, unsigned int count)
+{
+    // points are only ever appended, so the first n points are the same for any count >= n
+    std::uniform_int_distribution<int> d(0, _params.size - 1);
+    while (octave.xs.size() < count)
+    {
+        int x = d(octave.rand);
+        int y = d(octave.rand);
+        octave.xs.push_back(x);
+        octave.ys.push_back(y);
+    }
+    octave.count = count;
+}
+
+void WorleyGenerator::reserveCandidates(unsigned int count)
+{
+    if (_candidates.xs.size() < count)
+    {
+        _candidates.xs.resize(count);
+        _candidates.ys.resize(count);
+        _candidates.indices.resize(count);
+        _distances.resize(count);
+        _closest.resize(count);
+    }
+}
+
+void WorleyGenerator::gatherCandidates(const OctaveField &octave, unsigned int firstPoint)
+{
+    reserveCandidates(octave.count);
+    _candidates.count = 0;
+    for (unsigned int i = firstPoint; i < octave.count; i++)
+    {
+        _candidates.xs[_candidates.count] = octave.xs[i];
+        _candidates.ys[_candidates.count] = octave.ys[i];
+        _candidates.indices[_candidates.count] = i;
+        _candidates.count++;
+    }
+}
+
+template <typename Metric>
+float WorleyGenerator::getCullingBox(const Metric &metric, const OctaveField &octave, unsigned int blockSize) const
+{
+    // With a point within pointReach of every pixel, the spots just past the reach of that closest point are covered
+    // by others, so the second closest is within 3 * pointReach on both axes. A point further than the box on either
+    // axis has a larger key than that for every pixel of a block. Not worth the grid lookups unless the box around a
+    // block leaves out most of the tile, and past half the tile the points would meet their wrapped selves.
+    const float size = _params.size;
+    if (octave.pointReach <= 0.0f)
+    {
+        return 0.0f;
+    }
+    const float bound = 3.0f * octave.pointReach, boundKey = metric(bound, bound);
+    float box = bound;
+    while (metric(box, 0.0f) <= boundKey && box < size)
+    {
+        box *= 1.02f;
+    }
+    const float cellSize = size / octave.gridSize;
+    return 2.0f * (box + cellSize) + blockSize < size * 0.5f ? box : 0.0f;
+}
+
+template <typename Metric>
+void WorleyGenerator::cullCandidates(const Metric &metric, const OctaveField &octave, float box, unsigned int firstX, unsigned int firstY, unsigned int lastX, unsigned int lastY)
+{
+    // Every pixel of the block is within the furthest key of a point and no closer than its closest key. Two points
+    // are within the second smallest furthest key of every pixel, so a point whose closest key is larger can't be
+    // among the two closest of any pixel of the block.
+    reserveCandidates(octave.count);
+    const float size = _params.size;
+    unsigned int *indices = _candidates.indices.data();
+    unsigned int count = 0;
+
+    // only the grid cells within box of the block, sorted back into point order after
+    if (box > 0.0f)
+    {
+        const int gridSize = octave.gridSize;
+        const int firstCellX = (int)std::floor((firstX - box) * gridSize / size), lastCellX = (int)std::floor((lastX + box) * gridSize / size);
+        const int firstCellY = (int)std::floor((firstY - box) * gridSize / size), lastCellY = (int)std::floor((lastY + box) * gridSize / size);
+        for (int cellY = firstCellY; cellY <= lastCellY; cellY++)
+        {
+            const int rowStart = (cellY % gridSize + gridSize) % gridSize * gridSize;
+            for (int cellX = firstCellX; cellX <= lastCellX; cellX++)
+            {
+                const int cell = rowStart + (cellX % gridSize + gridSize) % gridSize;
+                for (unsigned int j = octave.cellStarts[cell]; j < octave.cellStarts[cell + 1]; j++)
+                {
+                    indices[count++] = octave.cellPoints[j];
+                }
+            }
+        }
+        std::sort(indices, indices + count);
+    }
+    if (count == 0)
+    {
+        for (unsigned int i = 0; i < octave.count; i++)
+        {
+            indices[i] = i;
+        }
+        count = octave.count;
+    }
+
+    float *closest = _closest.data();
+    float furthest1 = NO_DISTANCE, furthest2 = NO_DISTANCE;
+    for (unsigned int j = 0; j < count; j++)
+    {
+        const unsigned int i = indices[j];
+        float closestX, furthestX, closestY, furthestY;
+        getAxisBounds(octave.xs[i], firstX, lastX, size, closestX, furthestX);
+        getAxisBounds(octave.ys[i], firstY, lastY, size, closestY, furthestY);
+        closest[j] = metric(closestX, closestY);
+        float furthest = metric(furthestX, furthestY);
+        if (furthest < furthest1)
+        {
+            furthest2 = furthest1;
+            furthest1 = furthest;
+        }
+        else if (furthest < furthest2)
+        {
+            furthest2 = furthest;
+        }
+    }
+
+    // ties are kept, a full scan could pick them as well; compacted in place, never ahead of the index it reads
+    _candidates.count = 0;
+    for (unsigned int j = 0; j < count; j++)
+    {
+        if (closest[j] <= furthest2)
+        {
+            const unsigned int i = indices[j];
+            _candidates.xs[_candidates.count] = octave.xs[i];
+            _candidates.ys[_candidates.count] = octave.ys[i];
+            _candidates.indices[_candidates.count] = i;
+            _candidates.count++;
+        }
+    }
+}
+
+template <typename Metric>
+void WorleyGenerator::samplePixel(const Metric &metric, OctaveField &octave, unsigned int x, unsigned int y, bool keepPrevious)
+{
+    const unsigned int index = y * _params.size + x;
+    float f1 = octave.f1[index], f2 = octave.f2[index];
+    unsigned int nearest1 = octave.nearest1[index], nearest2 = octave.nearest2[index];
+    if (!keepPrevious)
+    {
+        f1 = f2 = NO_DISTANCE;
+    }
+
+    // distances to every candidate first, branch free so the compiler can vectorize it
+    const float size = _params.size, currentX = x, currentY = y;
+    const float *xs = _candidates.xs.data(), *ys = _candidates.ys.data();
+    const unsigned int count = _candidates.count;
+    float *distances = _distances.data();
+    for (unsigned int i = 0; i < count; i++)
+    {
+        float dx = std::abs(currentX - xs[i]);
+        float dy = std::abs(currentY - ys[i]);
+        distances[i] = metric(std::min(dx, size - dx), std::min(dy, size - dy));
+    }
+
+    // then keep the two closest, tracked as candidate positions (past the end for the kept ones) so the loop
+    // doesn't load point indices
+    const unsigned int KEPT1 = count, KEPT2 = count + 1;
+    unsigned int closest1 = KEPT1, closest2 = KEPT2;
+    for (unsigned int i = 0; i < count; i++)
+    {
+        float distance = distances[i];
+        if (distance < f1)
+        {
+            f2 = f1;
+            closest2 = closest1;
+            f1 = distance;
+            closest1 = i;
+        }
+        else if (distance < f2)
+        {
+            f2 = distance;
+            closest2 = i;
+        }
+    }
+    const unsigned int *indices = _candidates.indices.data();
+    unsigned int previous1 = nearest1, previous2 = nearest2;
+    nearest1 = closest1 == KEPT1 ? previous1 : closest1 == KEPT2 ? previous2 : indices[closest1];
+    nearest2 = closest2 == KEPT1 ? previous1 : closest2 == KEPT2 ? previous2 : indices[closest2];
+
+    octave.f1[index] = f1;
+    octave.f2[index] = f2;
+    octave.nearest1[index] = nearest1;
+    octave.nearest2[index] = nearest2;
+}
+
+template <typename Metric>
+bool WorleyGenerator::sampleOctave(const Metric &metric, OctaveField &octave, unsigned int step, bool skipCoarser, const std::function<bool()> &isCancelled)
+{
+    // pixels are sampled in blocks, each only against the points that can be among the closest two of its pixels
+    const unsigned int size = _params.size, blockSize = BLOCK_SAMPLES * step;
+    const float box = getCullingBox(metric, octave, blockSize);
+    for (unsigned int blockY = 0; blockY < size; blockY += blockSize)
+    {
+        if (isCancelled && isCancelled())
+        {
+            return false;
+        }
+
+        for (unsigned int blockX = 0; blockX < size; blockX += blockSize)
+        {
+            unsigned int lastX = std::min(blockX + blockSize, size) - 1;
+            unsigned int lastY = std::min(blockY + blockSize, size) - 1;
+            cullCandidates(metric, octave, box, blockX, blockY, lastX, lastY);
+            for (unsigned int y = blockY; y <= lastY; y += step)
+            {
+                for (unsigned int x = blockX; x <= lastX; x += step)
+                {
+                    // already sampled by a coarser pass
+                    if (skipCoarser && x % (step * 2) == 0 && y % (step * 2) == 0)
+                    {
+                        continue;
+                    }
+
+                    samplePixel(metric, octave, x, y, false);
+                }
+            }
+        }
+    }
+
+    return true;
+}
+
+bool WorleyGenerator::sampleEdges(OctaveField &octave, unsigned int step, bool skipCoarser, const std::function<bool()> &isCancelled)
+{
+    reserveCandidates(octave.count);
+    const unsigned int size = _params.size, blockSize = BLOCK_SAMPLES * step;
+    for (unsigned int blockY = 0; blockY < size; blockY += blockSize)
+    {
+        if (isCancelled && isCancelled())
+        {
+            return false;
+        }
+
+        for (unsigned int blockX = 0; blockX < size; blockX += blockSize)
+        {
+            unsigned int lastX = std::min(blockX + blockSize, size) - 1;
+            unsigned int lastY = std::min(blockY + blockSize, size) - 1;
+
+            // The border with the second closest point bounds the distance to the closest border, and only points
+            // within F1 + 2 * that distance can have a closer one. The furthest reach over the block limits the
+            // candidates like the culling of the sampling pass does.
+            _candidates.count = 0;
+            if (_params.metric == WorleyMetric::Euclidean)
+            {
+                float reach = 0.0f;
+                for (unsigned int y = blockY; y <= lastY; y += step)
+                {
+                    for (unsigned int x = blockX; x <= lastX; x += step)
+                    {
+                        reach = std::max(reach, std::sqrt(octave.f1[y * size + x]) + 2.0f * getSecondBorderDistance(octave, x, y));
+                    }
+                }
+
+                for (unsigned int i = 0; i < octave.count; i++)
+                {
+                    float closestX, furthestX, closestY, furthestY;
+                    getAxisBounds(octave.xs[i], blockX, lastX, size, closestX, furthestX);
+                    getAxisBounds(octave.ys[i], blockY, lastY, size, closestY, furthestY);
+                    if (closestX * closestX + closestY * closestY <= reach * reach)
+                    {
+                        _candidates.xs[_candidates.count] = octave.xs[i];
+                        _candidates.ys[_candidates.count] = octave.ys[i];
+                        _candidates.indices[_candidates.count] = i;
+                        _candidates.count++;
+                    }
+                }
+            }
+
+            for (unsigned int y = blockY; y <= lastY; y += step)
+            {
+                for (unsigned int x = blockX; x <= lastX; x += step)
+                {
+                    // already done by a coarser pass
+                    if (skipCoarser && x % (step * 2) == 0 && y % (step * 2) == 0)
+                    {
+                        continue;
+                    }
+
+                    octave.edges[y * size + x] = getEdgeDistance(octave, x, y);
+                }
+            }
+        }
+    }
+
+    return true;
+}
+
+// distance from the origin to the border between a and b, both relative to it, infinite for the same position
+static float getBorderDistance(float ax, float ay, float aKey, float bx, float by, float bKey)
+{
+    float abx = bx - ax, aby = by - ay;
+    if (abx == 0.0f && aby == 0.0f)
+    {
+        return NO_DISTANCE;
+    }
+
+    return (bKey - aKey) / (2.0f * std::sqrt(abx * abx + aby * aby));
+}
+
+// edge, or the distance to the border between a and b if that is closer, compared squared so most borders cost no root
+static float getCloserBorderDistance(float edge, float ax, float ay, float aKey, float bx, float by, float bKey)
+{
+    float abx = bx - ax, aby = by - ay;
+    float abKey = abx * abx + aby * aby, gap = bKey - aKey;
+    if (abKey == 0.0f || gap * gap >= 4.0f * edge * edge * abKey)
+    {
+        return edge;
+    }
+
+    return gap / (2.0f * std::sqrt(abKey));
+}
+
+float WorleyGenerator::getSecondBorderDistance(const OctaveField &octave, unsigned int x, unsigned int y) const
+{
+    const unsigned int index = y * _params.size + x;
+    if (octave.f2[index] == NO_DISTANCE)
+    {
+        return NO_DISTANCE;
+    }
+
+    const float size = _params.size;
+    const unsigned int nearest1 = octave.nearest1[index], nearest2 = octave.nearest2[index];
+    return getBorderDistance(wrapOffset(octave.xs[nearest1] - x, size), wrapOffset(octave.ys[nearest1] - y, size), octave.f1[index],
+                             wrapOffset(octave.xs[nearest2] - x, size), wrapOffset(octave.ys[nearest2] - y, size), octave.f2[index]);
+}
+
+float WorleyGenerator::getEdgeDistance(const OctaveField &octave, unsigned int x, unsigned int y)
+{
+    const unsigned int index = y * _params.size + x;
+    if (_params.metric != WorleyMetric::Euclidean)
+    {
+        // the borders aren't straight
+        float f1 = keyToDistance(octave.f1[index], _params), f2 = keyToDistance(octave.f2[index], _params);
+        return std::min((f2 - f1) * 0.5f, (float)_params.size);
+    }
+
+    // Every candidate b has a border with the closest point a, at (|b|^2 - |a|^2) / (2 |b - a|) relative to the
+    // pixel. Those go first, branch free so the compiler can vectorize it.
+    const float size = _params.size, halfSize = size * 0.5f;
+    const unsigned int nearest = octave.nearest1[index];
+    const float ax = wrapOffset(octave.xs[nearest] - x, size), ay = wrapOffset(octave.ys[nearest] - y, size);
+    const float aKey = octave.f1[index];
+    const float *xs = _candidates.xs.data(), *ys = _candidates.ys.data();
+    const unsigned int count = _candidates.count;
+    float *borders = _distances.data();
+    for (unsigned int i = 0; i < count; i++)
+    {
+        float bx = wrapOffset(xs[i] - x, size), by = wrapOffset(ys[i] - y, size);
+        float abx = bx - ax, aby = by - ay;
+        float abKey = abx * abx + aby * aby;
+        // a point on top of a has no border, offsets are whole pixels so any other abKey is at least 1
+        float gap = bx * bx + by * by - aKey + (abKey == 0.0f ? NO_DISTANCE : 0.0f);
+        borders[i] = gap / (2.0f * std::sqrt(std::max(abKey, 1.0f)));
+    }
+
+    float edge = getSecondBorderDistance(octave, x, y);
+    for (unsigned int i = 0; i < count; i++)
+    {
+        edge = std::min(edge, borders[i]);
+    }
+
+    // the copies of the candidates on the neighboring tiles have borders too, but they are at least half a tile away
+    // and a border is at least (|b| - |a|) / 2
+    const float a = std::sqrt(aKey);
+    for (unsigned int i = 0; i < count && a + 2.0f * edge > halfSize; i++)
+    {
+        float bx = wrapOffset(xs[i] - x, size), by = wrapOffset(ys[i] - y, size);
+        for (int copyY = -1; copyY <= 1; copyY++)
+        {
+            for (int copyX = -1; copyX <= 1; copyX++)
+            {
+                if (copyX != 0 || copyY != 0)
+                {
+                    float copyBx = bx + copyX * size, copyBy = by + copyY * size;
+                    edge = getCloserBorderDistance(edge, ax, ay, aKey, copyBx, copyBy, copyBx * copyBx + copyBy * copyBy);
+                }
+            }
+        }
+    }
+
+    return edge;
+}
+
+void WorleyGenerator::buildToneLut()
+{
+    // only integer keys can index the table, the keys past it are either all saturated or toned directly
+    _toneLut.clear();
+    _toneLutSaturates = false;
+    if (_params.metric == WorleyMetric::Minkowski)
+    {
+        return;
+    }
+
+    float saturationKey = std::ceil(distanceToKey(getSaturationDistance(_params), _params));
+    unsigned int lutSize = std::min((float)MAX_TONE_LUT_SIZE, saturationKey + 1.0f);
+    _toneLutSaturates = lutSize == saturationKey + 1.0f;
+    _toneLut.resize(lutSize);
+    for (unsigned int key = 0; key < lutSize; key++)
+    {
+        // in double so the integer part of every square root is exact
+        double distance = _params.metric == WorleyMetric::Euclidean ? std::sqrt((double)key) : key;
+        _toneLut[key] = toneDistance(distance, _params);
+    }
+}
+
+// counts the distance of the mode of params into bins spread over [0, size]
+static void addToHistogram(float f1, float f2, float edge, const WorleyParams &params, std::vector<unsigned int> &bins)
+{
+    float distance = keyToDistance(f1, params);
+    if (params.mode == WorleyDistanceMode::F2)
+    {
+        distance = keyToDistance(f2, params);
+    }
+    else if (params.mode == WorleyDistanceMode::F2MinusF1)
+    {
+        distance = keyToDistance(f2, params) - distance;
+    }
+    else if (params.mode == WorleyDistanceMode::Edge)
+    {
+        distance = edge;
+    }
+
+    // a single point has no second closest one
+    if (distance == NO_DISTANCE)
+    {
+        return;
+    }
+    bins[std::min<unsigned int>(distance * ((float)WORLEY_HISTOGRAM_BINS / params.size), WORLEY_HISTOGRAM_BINS - 1)]++;
+}
+
+void WorleyGenerator::accumulateHistogram(std::vector<unsigned int> &bins) const
+{
+    bins.resize(WORLEY_HISTOGRAM_BINS);
+    for (const OctaveField &octave : _octaves)
+    {
+        for (unsigned int i = 0; i < octave.f1.size(); i++)
+        {
+            addToHistogram(octave.f1[i], octave.f2[i], octave.edges[i], _params, bins);
+        }
+    }
+}
+
+void WorleyGenerator::renderFromPoints(std::uint8_t *pixels, std::size_t stride) const
+{
+    for (unsigned int y = 0; y < _params.size; y++)
+    {
+        std::uint8_t *row = pixels + y * stride;
+        for (unsigned int x = 0; x < _params.size; x++)
+        {
+            row[x] = sample(x, y);
+        }
+    }
+}
+
+void WorleyGenerator::accumulateHistogramFromPoints(std::vector<unsigned int> &bins) const
+{
+    switch (_params.metric)
+    {
+    case WorleyMetric::Manhattan:
+        return accumulateHistogramWith(ManhattanMetric(), bins);
+    case WorleyMetric::Chebyshev:
+        return accumulateHistogramWith(ChebyshevMetric(), bins);
+    case WorleyMetric::Minkowski:
+        return accumulateHistogramWith(MinkowskiMetric{_params.minkowskiExponent}, bins);
+    default:
+        return accumulateHistogramWith(EuclideanMetric(), bins);
+    }
+}
+
+template <typename Metric>
+void WorleyGenerator::accumulateHistogramWith(const Metric &metric, std::vector<unsigned int> &bins) const
+{
+    // the same closest points sample finds for every whole pixel, so the same counts as from the fields
+    bins.resize(WORLEY_HISTOGRAM_BINS);
+    for (const OctaveField &octave : _octaves)
+    {
+        for (unsigned int y = 0; y < _params.size; y++)
+        {
+            for (unsigned int x = 0; x < _params.size; x++)
+            {
+                float f1, f2;
+                unsigned int nearest1, nearest2;
+                findClosestPoints(metric, octave, x, y, f1, f2, nearest1, nearest2);
+                float edge = _params.mode == WorleyDistanceMode::Edge ? findEdgeDistance(octave, x, y, f1, f2, nearest1, nearest2) : 0.0f;
+                addToHistogram(f1, f2, edge, _params, bins);
+            }
+        }
+    }
+}
+
+void findWorleyToneRange(const std::vector<unsigned int> &bins, unsigned int size, float percentile, float &rangeMin, float &rangeMax)
+{
+    std::uint64_t total = 0;
+    for (unsigned int count : bins)
+    {
+        total += count;
+    }
+
+    // lower edge of the first bin past the low percentile, upper edge of the last bin before the high one
+    const float distancePerBin = (float)size / bins.size();
+    const double low = total * percentile / 100.0, high = total * (100.0 - percentile) / 100.0;
+    std::uint64_t counted = 0;
+    rangeMin = 0.0f;
+    rangeMax = size;
+    bool foundMin = false;
+    for (unsigned int i = 0; i < bins.size(); i++)
+    {
+        if (!foundMin && bins[i] > 0 && counted + bins[i] > low)
+        {
+            rangeMin = i * distancePerBin;
+            foundMin = true;
+        }
+        counted += bins[i];
+        if (counted >= high && bins[i] > 0)
+        {
+            rangeMax = (i + 1) * distancePerBin;
+            break;
+        }
+    }
+}
+
+std::uint8_t WorleyGenerator::toneKey(float key) const
+{
+    if (key < _toneLut.size())
+    {
+        return _toneLut[(unsigned int)key];
+    }
+    if (_toneLutSaturates)
+    {
+        return _toneLut.back();
+    }
+
+    return toneDistance(keyToDistance(key, _params), _params);
+}
+
+// every octave weighs half as much as the previous one
+template <typename OctaveColor>
+static std::uint8_t blendOctaves(unsigned int octaves, const OctaveColor &getOctaveColor)
+{
+    if (octaves == 1)
+    {
+        return getOctaveColor(0);
+    }
+
+    float color = 0.0f, weights = 0.0f, weight = 1.0f;
+    for (unsigned int i = 0; i < octaves; i++)
+    {
+        color += weight * getOctaveColor(i);
+        weights += weight;
+        weight *= 0.5f;
+    }
+
+    return std::lround(color / weights);
+}
+
+std::uint8_t WorleyGenerator::toneOctave(float f1, float f2, float edge) const
+{
+    if (_params.mode == WorleyDistanceMode::F2MinusF1)
+    {
+        return toneDistance(keyToDistance(f2, _params) - keyToDistance(f1, _params), _params);
+    }
+    if (_params.mode == WorleyDistanceMode::Edge)
+    {
+        return toneDistance(edge, _params);
+    }
+
+    // pixels only ever have whole keys, the table doesn't know the ones sample finds between pixels
+    float key = _params.mode == WorleyDistanceMode::F2 ? f2 : f1;
+    return key == std::floor(key) ? toneKey(key) : toneDistance(keyToDistance(key, _params), _params);
+}
+
+std::uint8_t WorleyGenerator::tonePixel(unsigned int index) const
+{
+    return blendOctaves(_octaves.size(), [this, index](unsigned int i)
+    {
+        const OctaveField &octave = _octaves[i];
+        return toneOctave(octave.f1[index], octave.f2[index], octave.edges[index]);
+    });
+}
+
+std::uint8_t WorleyGenerator::sample(float x, float y) const
+{
+    std::uint8_t value;
+    sampleMany(&x, &y, 1, &value);
+    return value;
+}
+
+void WorleyGenerator::sampleMany(const float *xs, const float *ys, std::size_t count, std::uint8_t *values) const
+{
+    switch (_params.metric)
+    {
+    case WorleyMetric::Manhattan:
+        for (std::size_t i = 0; i < count; i++)
+        {
+            values[i] = sampleWith(ManhattanMetric(), xs[i], ys[i]);
+        }
+        break;
+    case WorleyMetric::Chebyshev:
+        for (std::size_t i = 0; i < count; i++)
+        {
+            values[i] = sampleWith(ChebyshevMetric(), xs[i], ys[i]);
+        }
+        break;
+    case WorleyMetric::Minkowski:
+        for (std::size_t i = 0; i < count; i++)
+        {
+            values[i] = sampleWith(MinkowskiMetric{_params.minkowskiExponent}, xs[i], ys[i]);
+        }
+        break;
+    default:
+        for (std::size_t i = 0; i < count; i++)
+        {
+            values[i] = sampleWith(EuclideanMetric(), xs[i], ys[i]);
+        }
+        break;
+    }
+}
+
+static std::uint32_t floatBits(float value)
+{
+    std::uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
+static float bitsFloat(std::uint32_t bits)
+{
+    float value;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+// grid cell positions one grid off on either side wrapped back into it
+static int wrapCell(int cell, int gridSize)
+{
+    return cell < 0 ? cell + gridSize : cell >= gridSize ? cell - gridSize : cell;
+}
+
+// Shortest distance along an axis from a position to the points of a grid cell ring cells away. The cell of a
+// position goes by its whole pixel, which can be up to a pixel further.
+static float getCellGap(int ring, float cellWidth)
+{
+    return std::max((ring - 1) * cellWidth - 1.0f, 0.0f);
+}
+
+template <typename Metric>
+std::uint8_t WorleyGenerator::sampleWith(const Metric &metric, float x, float y) const
+{
+    const float size = _params.size;
+    x -= std::floor(x / size) * size;
+    y -= std::floor(y / size) * size;
+    // the rounding above can land right on the far edge
+    x = x >= size ? 0.0f : x;
+    y = y >= size ? 0.0f : y;
+
+    return blendOctaves(_octaves.size(), [&](unsigned int i)
+    {
+        const OctaveField &octave = _octaves[i];
+        float f1, f2;
+        unsigned int nearest1, nearest2;
+        findClosestPoints(metric, octave, x, y, f1, f2, nearest1, nearest2);
+        float edge = _params.mode == WorleyDistanceMode::Edge ? findEdgeDistance(octave, x, y, f1, f2, nearest1, nearest2) : 0.0f;
+        return toneOctave(f1, f2, edge);
+    });
+}
+
+template <typename Metric>
+void WorleyGenerator::findClosestPoints(const Metric &metric, const OctaveField &octave, float x, float y, float &f1, float &f2, unsigned int &nearest1, unsigned int &nearest2) const
+{
+    // rings of grid cells around the one of (x, y), each cell visited once however small the grid, until the next
+    // ring is further than the second closest point
+    const unsigned int size = _params.size, gridSize = octave.gridSize;
+    const float fullSize = size, cellWidth = size / gridSize; // rounded down, keeping the gaps on the short side
+    const int cellX = (unsigned int)x * gridSize / size, cellY = (unsigned int)y * gridSize / size;
+    const int lowest = -(int)((gridSize - 1) / 2), highest = gridSize / 2;
+    // Distances are never negative, so their bits sort like them: with the point index below, the two smallest
+    // keys are the two closest points with ties going to the earlier point like in samplePixel, kept branch free.
+    auto getFound = [](float distance, unsigned int i) { return (std::uint64_t)floatBits(distance) << 32 | i; };
+    std::uint64_t found1 = getFound(NO_DISTANCE, 0), found2 = found1;
+    for (int ring = 0; ring <= highest && metric(getCellGap(ring, cellWidth), 0.0f) <= bitsFloat(found2 >> 32); ring++)
+    {
+        for (int offsetY = std::max(-ring, lowest); offsetY <= std::min(ring, highest); offsetY++)
+        {
+            // only the border of the ring, the inside was done by the previous rings
+            const bool borderRow = offsetY == -ring || offsetY == ring;
+            const int stepX = borderRow ? 1 : 2 * ring;
+            const int row = wrapCell(cellY + offsetY, gridSize) * gridSize;
+            for (int offsetX = -ring; offsetX <= ring; offsetX += stepX)
+            {
+                if (offsetX < lowest || offsetX > highest)
+                {
+                    continue;
+                }
+
+                const unsigned int cell = row + wrapCell(cellX + offsetX, gridSize);
+                for (unsigned int entry = octave.cellStarts[cell]; entry < octave.cellStarts[cell + 1]; entry++)
+                {
+                    const unsigned int i = octave.cellPoints[entry];
+                    float dx = std::abs(x - octave.xs[i]);
+                    float dy = std::abs(y - octave.ys[i]);
+                    std::uint64_t current = getFound(metric(std::min(dx, fullSize - dx), std::min(dy, fullSize - dy)), i);
+                    found2 = std::min(found2, std::max(found1, current));
+                    found1 = std::min(found1, current);
+                }
+            }
+        }
+    }
+
+    f1 = bitsFloat(found1 >> 32);
+    f2 = bitsFloat(found2 >> 32);
+    nearest1 = (std::uint32_t)found1;
+    nearest2 = (std::uint32_t)found2;
+}
+
+float WorleyGenerator::findEdgeDistance(const OctaveField &octave, float x, float y, float f1, float f2, unsigned int nearest1, unsigned int nearest2) const
+{
+    if (_params.metric != WorleyMetric::Euclidean)
+    {
+        return std::min((keyToDistance(f2, _params) - keyToDistance(f1, _params)) * 0.5f, (float)_params.size);
+    }
+
+    // the same borders as getEdgeDistance, over the points within F1 + 2 * the border with the second closest point
+    const float size = _params.size, halfSize = size * 0.5f;
+    const float ax = wrapOffset(octave.xs[nearest1] - x, size), ay = wrapOffset(octave.ys[nearest1] - y, size);
+    float edge = NO_DISTANCE;
+    if (f2 != NO_DISTANCE)
+    {
+        edge = getBorderDistance(ax, ay, f1, wrapOffset(octave.xs[nearest2] - x, size), wrapOffset(octave.ys[nearest2] - y, size), f2);
+    }
+
+    const unsigned int gridSize = octave.gridSize;
+    const float cellWidth = _params.size / gridSize;
+    const int cellX = (unsigned int)x * gridSize / _params.size, cellY = (unsigned int)y * gridSize / _params.size;
+    const int lowest = -(int)((gridSize - 1) / 2), highest = gridSize / 2;
+    const float a = std::sqrt(f1);
+    auto forEachCandidate = [&](const auto &visit)
+    {
+        // the rings of cells getCellGap puts within reach
+        const float reach = a + 2.0f * edge;
+        const int rings = std::min((float)highest, std::floor((reach + 1.0f) / cellWidth) + 1.0f);
+        for (int offsetY = std::max(-rings, lowest); offsetY <= std::min(rings, highest); offsetY++)
+        {
+            const int row = wrapCell(cellY + offsetY, gridSize) * gridSize;
+            for (int offsetX = std::max(-rings, lowest); offsetX <= std::min(rings, highest); offsetX++)
+            {
+                const unsigned int cell = row + wrapCell(cellX + offsetX, gridSize);
+                for (unsigned int entry = octave.cellStarts[cell]; entry < octave.cellStarts[cell + 1]; entry++)
+                {
+                    const unsigned int i = octave.cellPoints[entry];
+                    visit(wrapOffset(octave.xs[i] - x, size), wrapOffset(octave.ys[i] - y, size));
+                }
+            }
+        }
+    };
+
+    forEachCandidate([&](float bx, float by)
+    {
+        float abx = bx - ax, aby = by - ay;
+        float abKey = abx * abx + aby * aby;
+        float gap = bx * bx + by * by - f1 + (abKey == 0.0f ? NO_DISTANCE : 0.0f);
+        edge = std::min(edge, gap / (2.0f * std::sqrt(std::max(abKey, 1.0f))));
+    });
+
+    if (a + 2.0f * edge > halfSize)
+    {
+        forEachCandidate([&](float bx, float by)
+        {
+            for (int copyY = -1; copyY <= 1; copyY++)
+            {
+                for (int copyX = -1; copyX <= 1; copyX++)
+                {
+                    if ((copyX != 0 || copyY != 0) && a + 2.0f * edge > halfSize)
+                    {
+                        float copyBx = bx + copyX * size, copyBy = by + copyY * size;
+                        edge = getCloserBorderDistance(edge, ax, ay, f1, copyBx, copyBy, copyBx * copyBx + copyBy * copyBy);
+                    }
+                }
+            }
+        });
+    }
+
+    return edge;
+}
+
+std::vector<std::uint8_t> generateWorleyNoise(const WorleyParams &params)
+{
+    WorleyGenerator generator;
+    generator.update(params);
+
+    std::vector<std::uint8_t> pixels;
+    generator.render(pixels, 1);
+    return pixels;
+}
+
+static std::uint64_t hashBytes(std::uint64_t hash, const void *data, std::size_t size)
+{
+    // FNV-1a, the same on every platform and run
+    const std::uint8_t *bytes = (const std::uint8_t *)data;
+    for (std::size_t i = 0; i < size; i++)
+    {
+        hash = (hash ^ bytes[i]) * 0x100000001B3ull;
+    }
+    return hash;
+}
+
+std::uint64_t hashWorleyParams(const WorleyParams &params, const std::string &salt)
+{
+    const float floats[] = {params.minkowskiExponent, params.gamma, params.rangeMin, params.rangeMax};
+    std::uint32_t floatBits[4];
+    std::memcpy(floatBits, floats, sizeof(floatBits));
+    // a still tile has the same pixels whatever its frame, a loop's frames repeat after the last one
+    const std::uint32_t loopFrames = std::max(params.frames, 1u), loopFrame = loopFrames > 1 ? params.frame % loopFrames : 0;
+    const std::uint32_t fields[] = {WORLEY_GENERATOR_VERSION, params.seed, params.size, params.points,
+                                    (std::uint32_t)params.distribution, (std::uint32_t)params.mode, (std::uint32_t)params.metric, floatBits[0],
+                                    (std::uint32_t)params.curve, floatBits[1], floatBits[2], floatBits[3],
+                                    params.octaves, loopFrames, loopFrame};
+    std::uint64_t hash = 0xCBF29CE484222325ull;
+    hash = hashBytes(hash, fields, sizeof(fields));
+    hash = hashBytes(hash, params.customCurve.data(), params.customCurve.size());
+    return hashBytes(hash, salt.data(), salt.size());
+}
@@ -0,0 +1,226 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "poisson.hpp"
+
+// bump whenever the same parameters start producing different pixels
+const unsigned int WORLEY_GENERATOR_VERSION = 3;
+
+// how the feature points are scattered over the tile
+enum class WorleyPointDistribution
+{
+    Uniform, // independent random pixels, clumps and gaps included
+    Poisson  // blue noise, no two points closer than a radius picked for about the requested count
+};
+
+// which feature point distances make up the noise value
+enum class WorleyDistanceMode
+{
+    F1,        // distance to the closest point
+    F2,        // distance to the second closest point
+    F2MinusF1, // cell borders
+    Edge       // exact distance to the closest cell border, euclidean only, the other metrics use (F2 - F1) / 2
+};
+
+// how the distance between a pixel and a point is measured
+enum class WorleyMetric
+{
+    Euclidean,
+    Manhattan,
+    Chebyshev,
+    Minkowski // uses minkowskiExponent, 1 is Manhattan, 2 is Euclidean
+};
+
+// how a distance gets turned into a color
+// The curves besides Pretty map the distance range [rangeMin, rangeMax] to [0, 1] first, an empty range
+// meaning [0, size / 2], and all but Custom are inverted so the feature points end up bright.
+enum class WorleyRemapCurve
+{
+    Pretty,     // the original remap(distance, 0, 255, 0, 2048), inverted
+    Linear,
+    Gamma,      // normalized distance ^ gamma
+    Smoothstep,
+    Custom      // customCurve, 256 colors from the closest to the furthest distance
+};
+
+struct WorleyParams
+{
+    unsigned int seed = 0;
+    unsigned int size = 64;
+    unsigned int points = 13;
+    WorleyPointDistribution distribution = WorleyPointDistribution::Uniform;
+    WorleyDistanceMode mode = WorleyDistanceMode::F1;
+    WorleyMetric metric = WorleyMetric::Euclidean;
+    float minkowskiExponent = 3.0f;
+    WorleyRemapCurve curve = WorleyRemapCurve::Pretty;
+    float gamma = 2.2f;
+    float rangeMin = 0.0f;
+    float rangeMax = 0.0f;
+    std::vector<std::uint8_t> customCurve;
+    unsigned int octaves = 1;
+    // time loop: with frames > 1 every point goes around a path of its own that is back at the start after frames
+    // frames, frame is the moment to generate
+    unsigned int frames = 1;
+    unsigned int frame = 0;
+
+    bool operator==(const WorleyParams &other) const
+    {
+        return seed == other.seed && size == other.size && points == other.points &&
+               distribution == other.distribution && mode == other.mode &&
+               metric == other.metric && minkowskiExponent == other.minkowskiExponent && curve == other.curve &&
+               gamma == other.gamma && rangeMin == other.rangeMin && rangeMax == other.rangeMax &&
+               customCurve == other.customCurve && octaves == other.octaves && frames == other.frames &&
+               frame == other.frame;
+    }
+    bool operator!=(const WorleyParams &other) const { return !(*this == other); }
+};
+
+// Keeps the distance field of the last generated noise around so parameter changes only redo what they affect:
+// remap curve, tone range and distance mode only re-tone, octave and point count changes only touch the new octaves or the
+// pixels whose closest points changed, a new seed, size or metric rebuilds everything coarse to fine. A new frame
+// rebuilds too, but only moves the points instead of drawing them again.
+class WorleyGenerator
+{
+public:
+    // coarsest sampling step of a full rebuild, every pass halves it
+    static const unsigned int COARSEST_STEP = 8;
+    // samples per side of the pixel blocks full passes cull the feature points for
+    static const unsigned int BLOCK_SAMPLES = 16;
+
+    // Brings the distance field up to date with params. onPass(step) runs after every pass, after which
+    // render(step) gives a complete (blocky for steps > 1) image. Returns false when cancelled.
+    bool update(const WorleyParams &params, const std::function<void(unsigned int)> &onPass = nullptr, const std::function<bool()> &isCancelled = nullptr);
+
+    // tones the cached field into size * size pixels of channels bytes each (1, or 4 for RGBA with opaque alpha)
+    void render(std::vector<std::uint8_t> &pixels, unsigned int channels, unsigned int step = 1) const;
+    // same into caller owned memory, rows stride bytes apart
+    void render(std::uint8_t *pixels, std::size_t stride, unsigned int channels, unsigned int step = 1) const;
+
+    // Writes the untoned distances as size * size RGB floats: F1, F2 and F2 - F1, in tiles (distance / size) and
+    // with the octaves weighted like render does. A missing second closest point reads as 1.
+    void renderDistances(std::vector<float> &distances) const;
+    // same into caller owned memory, rows stride bytes apart
+    void renderDistances(float *distances, std::size_t stride) const;
+
+    // Colors the cells of the first octave (the pixels sharing a closest point) as size * size RGB bytes, hashed from
+    // the seed and the index of the point so every cell keeps its color across parameter changes.
+    void renderCells(std::vector<std::uint8_t> &pixels) const;
+    void renderCells(std::uint8_t *pixels, std::size_t stride) const;
+
+    // Writes size * size RGB floats about the closest point of the first octave: its x and y offset from the pixel
+    // in tiles, the shortest way around the tile, then its index.
+    void renderOffsets(std::vector<float> &offsets) const;
+    void renderOffsets(float *offsets, std::size_t stride) const;
+
+    // Places only the feature points of params, without sampling any pixel: enough for sample and sampleMany, not for
+    // render, which needs update. Far cheaper than update when only a few values are needed.
+    void updatePoints(const WorleyParams &params);
+
+    // The noise at (x, y) in pixels, wrapped into the tile, after update or updatePoints. On whole pixel coordinates
+    // it is the same byte render writes for that pixel, between them the same noise evaluated in between.
+    std::uint8_t sample(float x, float y) const;
+    // sample for count positions at once, the metric picked once for all of them
+    void sampleMany(const float *xs, const float *ys, std::size_t count, std::uint8_t *values) const;
+
+    // counts the distance (for the current mode) of every pixel of every octave into bins spread over [0, size]
+    void accumulateHistogram(std::vector<unsigned int> &bins) const;
+
+    // render (one channel) and accumulateHistogram after updatePoints, from the points alone: the same bytes and counts
+    // without the fields of update, so only the points take memory, at a few times the time
+    void renderFromPoints(std::uint8_t *pixels, std::size_t stride) const;
+    void accumulateHistogramFromPoints(std::vector<unsigned int> &bins) const;
+
+    const WorleyParams &params() const { return _params; }
+
+private:
+    struct OctaveField
+    {
+        std::mt19937 rand;           // continues the point sequence when points get added
+        std::vector<float> xs, ys;   // every point drawn so far, the first count are in use
+        std::vector<float> startXs, startYs; // where the points start their loops, only with frames > 1
+        unsigned int count = 0;
+        std::vector<float> f1, f2;   // closest and second closest distance key per pixel
+        std::vector<unsigned int> nearest1, nearest2;
+        std::vector<float> edges;    // distance to the closest cell border per pixel, only kept up to date in edge mode
+        unsigned int gridSize = 0;   // cells per side of the grid sample looks the points up in
+        std::vector<unsigned int> cellStarts; // where every cell starts in cellPoints, one more for the end
+        std::vector<unsigned int> cellPoints; // point indices cell by cell, in point order within a cell
+        float pointReach = 0.0f;     // every pixel has a point within this euclidean distance, 0 when there's no bound
+    };
+
+    // the points a pixel gets compared against, in point order so ties resolve like a full scan
+    struct Candidates
+    {
+        std::vector<float> xs, ys;
+        std::vector<unsigned int> indices;
+        unsigned int count = 0;
+    };
+
+    // the sampling loops are instantiated once per metric, so picking one costs nothing per pixel
+    template <typename Metric>
+    bool updateWith(const Metric &metric, const WorleyParams &params, const std::function<void(unsigned int)> &onPass, const std::function<bool()> &isCancelled);
+    template <typename Metric>
+    void samplePixel(const Metric &metric, OctaveField &octave, unsigned int x, unsigned int y, bool keepPrevious);
+    template <typename Metric>
+    float getCullingBox(const Metric &metric, const OctaveField &octave, unsigned int blockSize) const;
+    template <typename Metric>
+    void cullCandidates(const Metric &metric, const OctaveField &octave, float box, unsigned int firstX, unsigned int firstY, unsigned int lastX, unsigned int lastY);
+    template <typename Metric>
+    bool sampleOctave(const Metric &metric, OctaveField &octave, unsigned int step, bool skipCoarser, const std::function<bool()> &isCancelled);
+
+    template <typename Metric>
+    void accumulateHistogramWith(const Metric &metric, std::vector<unsigned int> &bins) const;
+    template <typename Metric>
+    std::uint8_t sampleWith(const Metric &metric, float x, float y) const;
+    template <typename Metric>
+    void findClosestPoints(const Metric &metric, const OctaveField &octave, float x, float y, float &f1, float &f2, unsigned int &nearest1, unsigned int &nearest2) const;
+    float findEdgeDistance(const OctaveField &octave, float x, float y, float f1, float f2, unsigned int nearest1, unsigned int nearest2) const;
+
+    bool sampleEdges(OctaveField &octave, unsigned int step, bool skipCoarser, const std::function<bool()> &isCancelled);
+    float getSecondBorderDistance(const OctaveField &octave, unsigned int x, unsigned int y) const;
+    float getEdgeDistance(const OctaveField &octave, unsigned int x, unsigned int y);
+
+    void resetOctave(OctaveField &octave, unsigned int index, bool keepPoints = false);
+    void resetOctavePoints(OctaveField &octave, unsigned int index);
+    void moveOctavePoints(OctaveField &octave, unsigned int index);
+    void buildPointGrids();
+    void buildPointGrid(OctaveField &octave);
+    void resizeOctavePoints(OctaveField &octave, unsigned int count);
+    void reserveCandidates(unsigned int count);
+    void gatherCandidates(const OctaveField &octave, unsigned int firstPoint);
+    void buildToneLut();
+    std::uint8_t toneKey(float key) const;
+    std::uint8_t tonePixel(unsigned int index) const;
+    std::uint8_t toneOctave(float f1, float f2, float edge) const;
+
+    WorleyParams _params;
+    std::vector<OctaveField> _octaves;
+    Candidates _candidates;
+    std::vector<float> _distances; // scratch for the distance keys (or borders) of one pixel to every candidate
+    std::vector<float> _closest;   // scratch for the closest distance key of a block to every point
+    PoissonScratch _poissonScratch;
+    mutable std::vector<float> _renderF1, _renderF2; // scratch of renderDistances, so rendering doesn't allocate either
+    std::vector<std::uint8_t> _toneLut; // color per integer distance key, remap folded in
+    bool _toneLutSaturates = false;     // every key past the table has the color of its last entry
+    bool _valid = false;
+};
+
+const unsigned int WORLEY_HISTOGRAM_BINS = 1024;
+
+// Finds the distance range between the lowest and highest percentile of a histogram from accumulateHistogram,
+// percentile 0 giving the plain min and max.
+void findWorleyToneRange(const std::vector<unsigned int> &bins, unsigned int size, float percentile, float &rangeMin, float &rangeMax);
+
+// stable hash of the generator version, every parameter and an extra salt (e.g. the output format)
+std::uint64_t hashWorleyParams(const WorleyParams &params, const std::string &salt = "");
+
+// generates one tile, single channel
+std::vector<std::uint8_t> generateWorleyNoise(const WorleyParams &params);
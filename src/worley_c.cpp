@@ -0,0 +1,230 @@
+#include "worley_c.h"
+
+#include <algorithm>
+#include <mutex>
+#include <new>
+#include <thread>
+
+#include "thread_pool.hpp"
+#include "worley.hpp"
+
+struct worley_context
+{
+    explicit worley_context(unsigned int threads) : pool(threads) {}
+
+    std::mutex mutex;          // worley_generate calls take turns on generator
+    WorleyGenerator generator;
+    ThreadPool pool;           // async generations, each thread with its own generator
+};
+
+struct WorleyTarget
+{
+    worley_output output;
+    void *out;
+    std::size_t stride;
+};
+
+// checks params and converts them, false when anything is out of range
+static bool convertParams(const worley_params &source, WorleyParams &params)
+{
+    // keeps size * size and the point count of the finest octave representable
+    if (source.size == 0 || source.size > WORLEY_MAX_SIZE || source.points == 0 || source.octaves == 0 || source.octaves > 16 ||
+        source.points > (0xFFFFFFFFu >> (2 * (source.octaves - 1))))
+    {
+        return false;
+    }
+    if ((unsigned int)source.distribution > WORLEY_DISTRIBUTION_POISSON || (unsigned int)source.mode > WORLEY_MODE_EDGE ||
+        (unsigned int)source.metric > WORLEY_METRIC_MINKOWSKI || (unsigned int)source.curve > WORLEY_CURVE_CUSTOM ||
+        (unsigned int)source.output > WORLEY_OUTPUT_OFFSETS)
+    {
+        return false;
+    }
+    if ((source.metric == WORLEY_METRIC_MINKOWSKI && !(source.minkowski_exponent > 0.0f)) ||
+        (source.curve == WORLEY_CURVE_CUSTOM && !source.custom_curve))
+    {
+        return false;
+    }
+
+    params.seed = source.seed;
+    params.size = source.size;
+    params.points = source.points;
+    params.octaves = source.octaves;
+    params.distribution = (WorleyPointDistribution)source.distribution;
+    params.mode = (WorleyDistanceMode)source.mode;
+    params.metric = (WorleyMetric)source.metric;
+    params.minkowskiExponent = source.minkowski_exponent;
+    params.curve = (WorleyRemapCurve)source.curve;
+    params.gamma = source.gamma;
+    params.rangeMin = source.range_min;
+    params.rangeMax = source.range_max;
+    if (source.curve == WORLEY_CURVE_CUSTOM)
+    {
+        params.customCurve.assign(source.custom_curve, source.custom_curve + 256);
+    }
+    return true;
+}
+
+static std::size_t getPixelBytes(worley_output output)
+{
+    switch (output)
+    {
+    case WORLEY_OUTPUT_RGBA:
+        return 4;
+    case WORLEY_OUTPUT_CELLS:
+        return 3;
+    case WORLEY_OUTPUT_DISTANCES:
+    case WORLEY_OUTPUT_OFFSETS:
+        return 3 * sizeof(float);
+    default:
+        return 1;
+    }
+}
+
+// brings generator up to date and renders straight into the target, no intermediate image
+static int generateInto(WorleyGenerator &generator, const WorleyParams &params, const WorleyTarget &target)
+{
+    try
+    {
+        generator.update(params);
+        switch (target.output)
+        {
+        case WORLEY_OUTPUT_NOISE:
+            generator.render((std::uint8_t *)target.out, target.stride, 1);
+            break;
+        case WORLEY_OUTPUT_RGBA:
+            generator.render((std::uint8_t *)target.out, target.stride, 4);
+            break;
+        case WORLEY_OUTPUT_CELLS:
+            generator.renderCells((std::uint8_t *)target.out, target.stride);
+            break;
+        case WORLEY_OUTPUT_DISTANCES:
+            generator.renderDistances((float *)target.out, target.stride);
+            break;
+        case WORLEY_OUTPUT_OFFSETS:
+            generator.renderOffsets((float *)target.out, target.stride);
+            break;
+        }
+    }
+    catch (const std::bad_alloc &)
+    {
+        // the field is half built, start over next time
+        generator = WorleyGenerator();
+        return WORLEY_ERROR_OUT_OF_MEMORY;
+    }
+    return WORLEY_OK;
+}
+
+// validates a call, filling params and target
+static int prepareCall(const worley_context *context, const worley_params *source, void *out, std::size_t stride, WorleyParams &params, WorleyTarget &target)
+{
+    if (!context || !source || !convertParams(*source, params))
+    {
+        return WORLEY_ERROR_INVALID_ARGUMENT;
+    }
+    if (!out || stride < worley_row_bytes(source))
+    {
+        return WORLEY_ERROR_INVALID_OUTPUT;
+    }
+    target = WorleyTarget{source->output, out, stride};
+    return WORLEY_OK;
+}
+
+void worley_default_params(worley_params *params)
+{
+    if (!params)
+    {
+        return;
+    }
+
+    WorleyParams defaults;
+    *params = worley_params{};
+    params->seed = defaults.seed;
+    params->size = defaults.size;
+    params->points = defaults.points;
+    params->octaves = defaults.octaves;
+    params->distribution = (worley_distribution)defaults.distribution;
+    params->mode = (worley_mode)defaults.mode;
+    params->metric = (worley_metric)defaults.metric;
+    params->minkowski_exponent = defaults.minkowskiExponent;
+    params->curve = (worley_curve)defaults.curve;
+    params->gamma = defaults.gamma;
+    params->range_min = defaults.rangeMin;
+    params->range_max = defaults.rangeMax;
+    params->output = WORLEY_OUTPUT_NOISE;
+}
+
+std::size_t worley_row_bytes(const worley_params *params)
+{
+    return params ? params->size * getPixelBytes(params->output) : 0;
+}
+
+worley_context *worley_create(unsigned int threads)
+{
+    try
+    {
+        return new worley_context(threads > 0 ? threads : std::thread::hardware_concurrency());
+    }
+    catch (...)
+    {
+        return nullptr;
+    }
+}
+
+void worley_destroy(worley_context *context)
+{
+    // the pool drains its queue before its threads stop
+    delete context;
+}
+
+int worley_generate(worley_context *context, const worley_params *params, void *out, std::size_t stride)
+{
+    WorleyParams converted;
+    WorleyTarget target;
+    int result = prepareCall(context, params, out, stride, converted, target);
+    if (result != WORLEY_OK)
+    {
+        return result;
+    }
+
+    std::lock_guard<std::mutex> lock(context->mutex);
+    return generateInto(context->generator, converted, target);
+}
+
+int worley_generate_async(worley_context *context, const worley_params *params, void *out, std::size_t stride,
+                          worley_callback done, void *user_data)
+{
+    WorleyParams converted;
+    WorleyTarget target;
+    int result = prepareCall(context, params, out, stride, converted, target);
+    if (result != WORLEY_OK)
+    {
+        return result;
+    }
+
+    try
+    {
+        context->pool.submit([converted, target, done, user_data]()
+        {
+            // lives as long as the pool thread, so repeated jobs on it stay incremental
+            thread_local WorleyGenerator generator;
+            int result = generateInto(generator, converted, target);
+            if (done)
+            {
+                done(user_data, result);
+            }
+        });
+    }
+    catch (const std::bad_alloc &)
+    {
+        return WORLEY_ERROR_OUT_OF_MEMORY;
+    }
+    return WORLEY_OK;
+}
+
+void worley_wait(worley_context *context)
+{
+    if (context)
+    {
+        context->pool.wait();
+    }
+}
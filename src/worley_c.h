@@ -0,0 +1,111 @@
+#pragma once
+
+/*
+ * Plain C interface of the generator, built as libworley without SFML or any of the tool around it.
+ * Every output is written straight into memory the caller owns, rows stride bytes apart, top row first.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#if defined(_WIN32)
+#define WORLEY_API __declspec(dllexport)
+#else
+#define WORLEY_API __attribute__((visibility("default")))
+#endif
+
+/* results, everything but WORLEY_OK leaves the output untouched */
+#define WORLEY_OK 0
+#define WORLEY_ERROR_INVALID_ARGUMENT -1 /* null context or params, or a parameter out of range */
+#define WORLEY_ERROR_INVALID_OUTPUT -2   /* null output or a stride shorter than worley_row_bytes */
+#define WORLEY_ERROR_OUT_OF_MEMORY -3
+
+/* largest size, the same as for batch jobs; a generator keeps about 20 bytes per pixel and octave */
+#define WORLEY_MAX_SIZE 4096
+
+/* values match the enums of worley.hpp */
+typedef enum worley_distribution { WORLEY_DISTRIBUTION_UNIFORM, WORLEY_DISTRIBUTION_POISSON } worley_distribution;
+typedef enum worley_mode { WORLEY_MODE_F1, WORLEY_MODE_F2, WORLEY_MODE_F2_MINUS_F1, WORLEY_MODE_EDGE } worley_mode;
+typedef enum worley_metric
+{
+    WORLEY_METRIC_EUCLIDEAN,
+    WORLEY_METRIC_MANHATTAN,
+    WORLEY_METRIC_CHEBYSHEV,
+    WORLEY_METRIC_MINKOWSKI
+} worley_metric;
+typedef enum worley_curve
+{
+    WORLEY_CURVE_PRETTY,
+    WORLEY_CURVE_LINEAR,
+    WORLEY_CURVE_GAMMA,
+    WORLEY_CURVE_SMOOTHSTEP,
+    WORLEY_CURVE_CUSTOM
+} worley_curve;
+
+/* what ends up in the output, per pixel */
+typedef enum worley_output
+{
+    WORLEY_OUTPUT_NOISE,     /* 1 byte, the toned noise */
+    WORLEY_OUTPUT_RGBA,      /* 4 bytes, the toned noise as gray with opaque alpha */
+    WORLEY_OUTPUT_CELLS,     /* 3 bytes, cell colors of the first octave */
+    WORLEY_OUTPUT_DISTANCES, /* 3 floats, F1, F2 and F2 - F1 in tiles */
+    WORLEY_OUTPUT_OFFSETS    /* 3 floats, x and y offset to the closest point in tiles, then its index */
+} worley_output;
+
+typedef struct worley_params
+{
+    uint32_t seed;
+    uint32_t size;   /* width and height in pixels, up to WORLEY_MAX_SIZE */
+    uint32_t points; /* feature points of the first octave, every further octave has 4 times more */
+    uint32_t octaves;
+    worley_distribution distribution;
+    worley_mode mode;
+    worley_metric metric;
+    float minkowski_exponent;
+    worley_curve curve;
+    float gamma;
+    float range_min, range_max;  /* distance range the curves map, both 0 for [0, size / 2] */
+    const uint8_t *custom_curve; /* 256 colors, read during the call only, for WORLEY_CURVE_CUSTOM */
+    worley_output output;
+} worley_params;
+
+typedef struct worley_context worley_context;
+
+/* called once an async generation is done, from one of the context threads */
+typedef void (*worley_callback)(void *user_data, int result);
+
+/* fills params with the defaults of the tool: 64 x 64, 13 points, F1, euclidean, noise output */
+WORLEY_API void worley_default_params(worley_params *params);
+
+/* smallest stride for params, size times the bytes per pixel of its output */
+WORLEY_API size_t worley_row_bytes(const worley_params *params);
+
+/* threads runs the async generations, 0 for one per core, returns null on failure */
+WORLEY_API worley_context *worley_create(unsigned int threads);
+
+/* waits for the pending async generations, their callbacks included */
+WORLEY_API void worley_destroy(worley_context *context);
+
+/*
+ * Generates params into out, blocking. Calls on one context take turns and reuse its distance field, so a
+ * sequence of small parameter changes only redoes what they affect.
+ */
+WORLEY_API int worley_generate(worley_context *context, const worley_params *params, void *out, size_t stride);
+
+/*
+ * Queues params for one of the context threads and returns right away, WORLEY_OK when queued. done gets the result,
+ * out has to stay valid until then. Parameters are checked before queueing, an error here means no callback.
+ */
+WORLEY_API int worley_generate_async(worley_context *context, const worley_params *params, void *out, size_t stride,
+                                     worley_callback done, void *user_data);
+
+/* blocks until every queued async generation has finished */
+WORLEY_API void worley_wait(worley_context *context);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,78 @@
+/* argument checks of the C library: bad parameters get an error code, never a crash */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "../src/worley_c.h"
+
+static int failures = 0;
+
+static void expect(int result, int expected, const char *what)
+{
+    if (result != expected)
+    {
+        printf("FAIL %s: got %d, expected %d\n", what, result, expected);
+        failures++;
+    }
+}
+
+int main(void)
+{
+    worley_context *context = worley_create(1);
+    worley_params params;
+    uint8_t *pixels = malloc(64 * 64);
+    if (!context || !pixels)
+    {
+        printf("FAIL setup\n");
+        return 1;
+    }
+
+    worley_default_params(&params);
+    expect(worley_generate(context, &params, pixels, 64), WORLEY_OK, "default params");
+    expect(worley_generate(NULL, &params, pixels, 64), WORLEY_ERROR_INVALID_ARGUMENT, "null context");
+    expect(worley_generate(context, NULL, pixels, 64), WORLEY_ERROR_INVALID_ARGUMENT, "null params");
+    expect(worley_generate(context, &params, NULL, 64), WORLEY_ERROR_INVALID_OUTPUT, "null output");
+    expect(worley_generate(context, &params, pixels, 63), WORLEY_ERROR_INVALID_OUTPUT, "short stride");
+
+    /* checked before the output, so the small buffer never gets written */
+    worley_default_params(&params);
+    params.size = 0;
+    expect(worley_generate(context, &params, pixels, 64), WORLEY_ERROR_INVALID_ARGUMENT, "size 0");
+    params.size = WORLEY_MAX_SIZE + 1;
+    expect(worley_generate(context, &params, pixels, 64), WORLEY_ERROR_INVALID_ARGUMENT, "size past WORLEY_MAX_SIZE");
+    params.size = 65536; /* size * size wraps to 0 in 32 bits */
+    expect(worley_generate(context, &params, pixels, (size_t)65536 * 4), WORLEY_ERROR_INVALID_ARGUMENT, "size 65536");
+    expect(worley_generate_async(context, &params, pixels, (size_t)65536 * 4, NULL, NULL), WORLEY_ERROR_INVALID_ARGUMENT,
+           "async size 65536");
+
+    worley_default_params(&params);
+    params.points = 0;
+    expect(worley_generate(context, &params, pixels, 64), WORLEY_ERROR_INVALID_ARGUMENT, "no points");
+    params.points = 1u << 25;
+    params.octaves = 5; /* 2^25 << 8 overflows */
+    expect(worley_generate(context, &params, pixels, 64), WORLEY_ERROR_INVALID_ARGUMENT, "finest octave overflow");
+    params.points = 13;
+    params.octaves = 0;
+    expect(worley_generate(context, &params, pixels, 64), WORLEY_ERROR_INVALID_ARGUMENT, "no octaves");
+    params.octaves = 17;
+    expect(worley_generate(context, &params, pixels, 64), WORLEY_ERROR_INVALID_ARGUMENT, "too many octaves");
+
+    worley_default_params(&params);
+    params.metric = WORLEY_METRIC_MINKOWSKI;
+    params.minkowski_exponent = 0.0f;
+    expect(worley_generate(context, &params, pixels, 64), WORLEY_ERROR_INVALID_ARGUMENT, "minkowski exponent 0");
+    worley_default_params(&params);
+    params.curve = WORLEY_CURVE_CUSTOM;
+    expect(worley_generate(context, &params, pixels, 64), WORLEY_ERROR_INVALID_ARGUMENT, "custom curve without colors");
+    worley_default_params(&params);
+    params.mode = (worley_mode)7;
+    expect(worley_generate(context, &params, pixels, 64), WORLEY_ERROR_INVALID_ARGUMENT, "unknown mode");
+
+    worley_destroy(context);
+    free(pixels);
+    if (failures == 0)
+    {
+        printf("worley_c_test: all checks passed\n");
+    }
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,80 @@
+/* incremental updates of the C library: a context that patches its fields in place renders the same bytes as a fresh one */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../src/worley_c.h"
+
+#define SIZE 128
+
+static int failures = 0;
+
+/* generates params on the kept context, then on a fresh one, and compares the two */
+static void expectSame(worley_context *kept, const worley_params *params, const char *what)
+{
+    static uint8_t patched[SIZE * SIZE], fresh[SIZE * SIZE];
+    worley_context *context = worley_create(1);
+    if (!context || worley_generate(kept, params, patched, SIZE) != WORLEY_OK ||
+        worley_generate(context, params, fresh, SIZE) != WORLEY_OK)
+    {
+        printf("FAIL %s: generation failed\n", what);
+        failures++;
+    }
+    else if (memcmp(patched, fresh, sizeof(patched)) != 0)
+    {
+        printf("FAIL %s: patched and fresh noise differ\n", what);
+        failures++;
+    }
+    worley_destroy(context);
+}
+
+int main(void)
+{
+    worley_context *context = worley_create(1);
+    worley_params params;
+    if (!context)
+    {
+        printf("FAIL setup\n");
+        return 1;
+    }
+
+    /* poisson points keep their own count, a patch must not resize them to the requested one */
+    worley_default_params(&params);
+    params.size = SIZE;
+    params.points = 8;
+    params.octaves = 2;
+    params.distribution = WORLEY_DISTRIBUTION_POISSON;
+    expectSame(context, &params, "poisson first generation");
+    params.curve = WORLEY_CURVE_LINEAR;
+    params.range_min = 2.0f;
+    params.range_max = 30.0f;
+    expectSame(context, &params, "poisson re-toned");
+    params.points = 12;
+    expectSame(context, &params, "poisson more points");
+    params.points = 6;
+    expectSame(context, &params, "poisson fewer points");
+    params.octaves = 3;
+    expectSame(context, &params, "poisson added octave");
+    params.mode = WORLEY_MODE_EDGE;
+    expectSame(context, &params, "poisson edges");
+    params.octaves = 1;
+    expectSame(context, &params, "poisson dropped octaves");
+
+    /* uniform points are the ones a patch adds and removes */
+    worley_default_params(&params);
+    params.size = SIZE;
+    params.points = 8;
+    expectSame(context, &params, "uniform first generation");
+    params.points = 12;
+    expectSame(context, &params, "uniform more points");
+    params.points = 5;
+    expectSame(context, &params, "uniform fewer points");
+
+    worley_destroy(context);
+    if (failures == 0)
+    {
+        printf("worley_incremental_test: all checks passed\n");
+    }
+    return failures == 0 ? 0 : 1;
+}